@@ -21,6 +21,8 @@
 #endif
 
 #include <pwd.h>
+#include <string.h>
+#include <sys/wait.h>
 
 #include <gtk/gtk.h>
 #include <gtk/gtkx.h>
@@ -35,10 +37,54 @@
 #include <libgnome-panel/gp-applet.h>
 
 #include "panel-glib.h"
+#include "launcher-sync.h"
+#include "plug-process.h"
+#include "launcher-strip.h"
 #include "dockbarx-applet.h"
 
 #define GRM_USER	".grm-user"
 
+#define PLUG_STOP_TIMEOUT	2000 /* ms until SIGKILL */
+#define STANDBY_DELAY		5 /* seconds after a start before the next standby */
+#define MONITORS_SETTLE_DELAY	500 /* ms without monitors-changed */
+
+#define RESTART_BACKOFF_MIN	500 /* ms before restarting a crashed plug */
+#define RESTART_BACKOFF_MAX	30000 /* ms */
+#define PLUG_STABLE_TIME	60 /* seconds up before a crash no longer counts as a loop */
+#define MAX_CRASHES			5 /* crashes in a row before falling back */
+#define MAX_EXIT_STATUSES	16
+
+#define WATCHDOG_INTERVAL	60 /* seconds between samples of the plug */
+#define WATCHDOG_CPU_WARN	50 /* % of one core over a whole interval */
+#define RECYCLE_RSS			400 /* MiB, GOOROOM_DOCKBARX_RECYCLE_RSS */
+#define RECYCLE_IDLE_TIME	120 /* seconds without input before recycling */
+#define RECYCLE_POSTPONE	30 /* samples over the limit before recycling without an idle monitor */
+#define POLICY_TIMEOUT		10 /* seconds the login agent gets to write .grm-user */
+#define ZYGOTE_TIMEOUT		20 /* seconds the zygote gets to import DockbarX */
+
+/* the login timeline, in the order things usually happen */
+typedef enum
+{
+	STAGE_APPLET_INIT,
+	STAGE_SYNC_START,
+	STAGE_SYNC_END,
+	STAGE_PLUG_SPAWN,
+	STAGE_PLUG_READY,
+	STAGE_PLUG_ADDED,
+	STAGE_PLUG_DRAWN,
+	N_STAGES
+} StartupStage;
+
+static const gchar *stage_names[N_STAGES] = {
+	"applet-init",
+	"sync-start",
+	"sync-end",
+	"plug-spawn",
+	"plug-ready",
+	"plug-added",
+	"plug-drawn"
+};
+
 
 struct _GooroomDockbarxAppletPrivate
 {
@@ -46,9 +92,68 @@ struct _GooroomDockbarxAppletPrivate
 
 	GSettings *dockbarx_settings;
 
+	GCancellable *cancellable;
+
+	PlugProcess *plug;
+	gboolean restarting;
+	/* the socket holds the window of the plug */
+	gboolean embedded;
+
+	/* GOOROOM_DOCKBARX_STANDBY=1: a loaded plug waits for the next
+	 * restart, the replaced ones are stopped in the background and
+	 * kept until they have been reaped */
+	gboolean standby_enabled;
+	PlugProcess *standby;
+	GSList *stopping;
+	guint standby_id;
+
+	/* monotonic time of the pending restart request, and how long the
+	 * last restart took until the new plug was embedded and loaded (us) */
+	gint64 restart_time;
+	gint64 restart_latency;
+
+	/* crashes of the plug: in a row, in total, and the wait statuses
+	 * of the last ones (-1 when it could not even be started) */
+	gint64 spawn_time;
+	guint crashes;
+	guint n_crashes;
+	GArray *exit_statuses;
+	guint backoff_id;
+	/* plain launchers once DockbarX keeps crashing */
+	GtkWidget *fallback;
+
+	/* imports the plug once and forks it from there, unless
+	 * GOOROOM_DOCKBARX_ZYGOTE=0; a start waits for it to be ready */
+	PlugProcess *zygote;
+	gchar *zygote_path;
+	gboolean zygote_waiting;
+	guint zygote_wait_id;
+
+	/* the last sample of the plug, its pid tells whether the CPU time
+	 * belongs to the same process */
+	guint watchdog_id;
+	GPid sample_pid;
+	guint64 plug_rss;
+	guint64 plug_cpu_time;
+	gboolean recycling;
+	guint recycle_waits;
+	/* MiB, 0 when off */
+	guint64 recycle_rss;
+	guint64 memory_limit;
+
+	/* monotonic time each stage was first reached (us), 0 until then */
+	gint64 stage_time[N_STAGES];
+	gboolean timeline_logged;
+	/* waits for the policy, then syncs once */
+	LauncherSyncWatch *sync_watch;
+	/* the last sync that went through */
+	LauncherSyncResult sync_result;
+	gboolean synced;
+
 	guint reg_id;
 	guint owner_id;
 	guint timeout_id;
+	guint monitors_id;
 
 	GDBusConnection *connection;
 };
@@ -65,6 +170,14 @@ static void handle_method_call (GDBusConnection *conn,
                                 GDBusMethodInvocation *invocation,
                                 gpointer data);
 
+static GVariant *handle_get_property (GDBusConnection *conn,
+                                      const gchar *sender,
+                                      const gchar *object_path,
+                                      const gchar *interface_name,
+                                      const gchar *property_name,
+                                      GError **error,
+                                      gpointer data);
+
 
 
 
@@ -72,12 +185,22 @@ static const gchar introspection_xml[] =
     "<node>"
     "  <interface name='kr.gooroom.dockbarx.applet'>"
     "    <method name='Restart'/>"
+    "    <method name='GetTimings'>"
+    "      <arg type='a{sx}' name='stages' direction='out'/>"
+    "      <arg type='a{sx}' name='sync_phases' direction='out'/>"
+    "    </method>"
+    "    <property name='RestartLatency' type='x' access='read'/>"
+    "    <property name='CrashCount' type='u' access='read'/>"
+    "    <property name='ExitStatuses' type='ai' access='read'/>"
+    "    <property name='Fallback' type='b' access='read'/>"
+    "    <property name='PlugRss' type='t' access='read'/>"
+    "    <property name='PlugCpuTime' type='t' access='read'/>"
     "  </interface>"
     "</node>";
 
 static const GDBusInterfaceVTable interface_vtable = {
     handle_method_call,
-    NULL,
+    handle_get_property,
     NULL
 };
 
@@ -128,29 +251,550 @@ gooroom_dockbarx_applet_dbus_init (GooroomDockbarxApplet *applet)
 	}
 }
 
-static gboolean
-gooroom_dockbarx_applet_dbus_init_idle (gpointer data)
+static gboolean start_dockbarx (GooroomDockbarxApplet *applet);
+static void kill_dockbarx (GooroomDockbarxApplet *applet);
+
+/* One line with every stage, once the dock is drawn and synced. */
+static void
+log_timeline (GooroomDockbarxApplet *applet)
+{
+	guint i, n_fields = 0;
+	gchar *message;
+	gchar *keys[N_STAGES], *values[N_STAGES];
+	GLogField fields[N_STAGES + 1];
+	GooroomDockbarxAppletPrivate *priv = applet->priv;
+
+	message = g_strdup_printf ("DockbarX drawn after %" G_GINT64_FORMAT " ms, launchers synced after %" G_GINT64_FORMAT " ms",
+                               (priv->stage_time[STAGE_PLUG_DRAWN] - priv->stage_time[STAGE_APPLET_INIT]) / 1000,
+                               (priv->stage_time[STAGE_SYNC_END] - priv->stage_time[STAGE_APPLET_INIT]) / 1000);
+	fields[n_fields++] = (GLogField) { "MESSAGE", message, -1 };
+
+	/* GOOROOM_DOCKBARX_PLUG_SPAWN_USEC, ... */
+	for (i = 0; i < N_STAGES; i++) {
+		gchar *name = g_ascii_strup (stage_names[i], -1);
+
+		g_strdelimit (name, "-", '_');
+		keys[i] = g_strdup_printf ("GOOROOM_DOCKBARX_%s_USEC", name);
+		g_free (name);
+
+		/* stages that never happened stay empty */
+		if (priv->stage_time[i] == 0)
+			values[i] = g_strdup ("");
+		else
+			values[i] = g_strdup_printf ("%" G_GINT64_FORMAT,
+                                         priv->stage_time[i] - priv->stage_time[STAGE_APPLET_INIT]);
+
+		fields[n_fields++] = (GLogField) { keys[i], values[i], -1 };
+	}
+
+	g_log_structured_array (G_LOG_LEVEL_MESSAGE, fields, n_fields);
+
+	for (i = 0; i < N_STAGES; i++) {
+		g_free (keys[i]);
+		g_free (values[i]);
+	}
+	g_free (message);
+}
+
+/* Only the first time counts, restarts are measured by RestartLatency. */
+static void
+mark_stage (GooroomDockbarxApplet *applet, StartupStage stage)
+{
+	gint64 elapsed;
+	GooroomDockbarxAppletPrivate *priv = applet->priv;
+
+	if (priv->stage_time[stage] != 0)
+		return;
+
+	priv->stage_time[stage] = g_get_monotonic_time ();
+	elapsed = priv->stage_time[stage] - priv->stage_time[STAGE_APPLET_INIT];
+
+	g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_INFO,
+                      "GOOROOM_DOCKBARX_STAGE", "%s", stage_names[stage],
+                      "GOOROOM_DOCKBARX_STAGE_USEC", "%" G_GINT64_FORMAT, elapsed,
+                      "MESSAGE", "DockbarX %s after %" G_GINT64_FORMAT " ms",
+                      stage_names[stage], elapsed / 1000);
+
+	if (!priv->timeline_logged &&
+        priv->stage_time[STAGE_PLUG_DRAWN] != 0 &&
+        priv->stage_time[STAGE_SYNC_END] != 0) {
+		priv->timeline_logged = TRUE;
+		log_timeline (applet);
+	}
+}
+
+static GVariant *
+get_timings (GooroomDockbarxApplet *applet)
+{
+	guint i;
+	GVariantBuilder stages, sync_phases;
+	GooroomDockbarxAppletPrivate *priv = applet->priv;
+
+	/* us since the applet was created */
+	g_variant_builder_init (&stages, G_VARIANT_TYPE ("a{sx}"));
+	for (i = 0; i < N_STAGES; i++) {
+		if (priv->stage_time[i] != 0)
+			g_variant_builder_add (&stages, "{sx}", stage_names[i],
+                                   priv->stage_time[i] - priv->stage_time[STAGE_APPLET_INIT]);
+	}
+
+	/* us spent in each phase */
+	g_variant_builder_init (&sync_phases, G_VARIANT_TYPE ("a{sx}"));
+	for (i = 0; priv->synced && i < LAUNCHER_SYNC_N_PHASES; i++) {
+		g_variant_builder_add (&sync_phases, "{sx}", launcher_sync_phase_get_name (i),
+                               priv->sync_result.phase_time[i]);
+	}
+
+	return g_variant_new ("(a{sx}a{sx})", &stages, &sync_phases);
+}
+
+static void
+send_dockbarx_command (GooroomDockbarxApplet *applet, const gchar *command)
+{
+	GooroomDockbarxAppletPrivate *priv = applet->priv;
+
+	if (plug_process_is_running (priv->plug))
+		plug_process_send (priv->plug, command);
+
+	/* keep the standby plug as current as the visible one */
+	if (plug_process_is_running (priv->standby))
+		plug_process_send (priv->standby, command);
+}
+
+/* A restart is done once the new plug is both embedded and loaded. */
+static void
+check_restart_done (GooroomDockbarxApplet *applet)
+{
+	GooroomDockbarxAppletPrivate *priv = applet->priv;
+
+	if (priv->restart_time == 0 || !priv->embedded || !plug_process_is_ready (priv->plug))
+		return;
+
+	priv->restart_latency = g_get_monotonic_time () - priv->restart_time;
+	priv->restart_time = 0;
+
+	g_message ("DockbarX restarted in %" G_GINT64_FORMAT " ms", priv->restart_latency / 1000);
+}
+
+static void
+plug_event_cb (PlugProcess *process, const gchar *event, gpointer data)
 {
 	GooroomDockbarxApplet *applet = GOOROOM_DOCKBARX_APPLET (data);
+	GooroomDockbarxAppletPrivate *priv = applet->priv;
+
+	/* a standby plug only matters once it is swapped in */
+	if (process != priv->plug)
+		return;
+
+	if (g_str_equal (event, "ready")) {
+		mark_stage (applet, STAGE_PLUG_READY);
+
+		/* Restart requests make sense from here on */
+		gooroom_dockbarx_applet_dbus_init (applet);
+		check_restart_done (applet);
+	} else if (g_str_equal (event, "drawn")) {
+		mark_stage (applet, STAGE_PLUG_DRAWN);
+	}
+}
+
+static gchar *
+describe_wait_status (gint status)
+{
+	if (status == -1)
+		return g_strdup ("could not be started");
+
+	if (status == PLUG_PROCESS_STATUS_LOST)
+		return g_strdup ("was lost along with the zygote");
+
+	if (status == PLUG_PROCESS_STATUS_NOT_FORKED)
+		return g_strdup ("could not be forked by the zygote");
 
+	if (WIFSIGNALED (status))
+		return g_strdup_printf ("was killed by signal %d (%s)",
+                                WTERMSIG (status), g_strsignal (WTERMSIG (status)));
+
+	if (WIFEXITED (status))
+		return g_strdup_printf ("exited with status %d", WEXITSTATUS (status));
+
+	return g_strdup ("stopped unexpectedly");
+}
+
+static void
+show_fallback (GooroomDockbarxApplet *applet)
+{
+	GooroomDockbarxAppletPrivate *priv = applet->priv;
+
+	if (priv->fallback)
+		return;
+
+	if (priv->socket) {
+		gtk_widget_destroy (priv->socket);
+		priv->socket = NULL;
+	}
+	priv->embedded = FALSE;
+
+	/* a standby would be running the same broken plug */
+	if (priv->standby_id > 0) {
+		g_source_remove (priv->standby_id);
+		priv->standby_id = 0;
+	}
+	g_clear_pointer (&priv->standby, plug_process_free);
+
+	priv->fallback = launcher_strip_new (priv->dockbarx_settings,
+                                         gp_applet_get_orientation (GP_APPLET (applet)));
+	gtk_container_add (GTK_CONTAINER (applet), priv->fallback);
+	gtk_widget_show (priv->fallback);
+
+	/* Restart is the way back to DockbarX */
 	gooroom_dockbarx_applet_dbus_init (applet);
+}
+
+static gboolean
+restart_crashed_dockbarx (gpointer data)
+{
+	GooroomDockbarxApplet *applet = GOOROOM_DOCKBARX_APPLET (data);
+	GooroomDockbarxAppletPrivate *priv = applet->priv;
+
+	priv->backoff_id = 0;
+
+	kill_dockbarx (applet);
 
 	return FALSE;
 }
 
+/* Restarts the plug with an exponential backoff, and gives up on it
+ * after MAX_CRASHES crashes in a row. */
+static void
+plug_crashed (GooroomDockbarxApplet *applet, gint status)
+{
+	guint delay;
+	gchar *reason;
+	GooroomDockbarxAppletPrivate *priv = applet->priv;
+
+	g_array_append_val (priv->exit_statuses, status);
+	if (priv->exit_statuses->len > MAX_EXIT_STATUSES)
+		g_array_remove_index (priv->exit_statuses, 0);
+	priv->n_crashes++;
+
+	/* a plug that was up for a while just had bad luck */
+	if (priv->spawn_time != 0 &&
+        g_get_monotonic_time () - priv->spawn_time >= PLUG_STABLE_TIME * G_USEC_PER_SEC)
+		priv->crashes = 0;
+	priv->crashes++;
+	priv->spawn_time = 0;
+
+	reason = describe_wait_status (status);
+
+	if (priv->crashes >= MAX_CRASHES) {
+		g_warning ("DockbarX %s, %u times in a row; showing plain launchers instead",
+                   reason, priv->crashes);
+		g_free (reason);
+		show_fallback (applet);
+		return;
+	}
+
+	/* 0.5s, 1s, 2s, ... with half of it random, so that desktops
+	 * sharing a bad policy do not retry in lockstep */
+	delay = MIN (RESTART_BACKOFF_MAX, RESTART_BACKOFF_MIN << (priv->crashes - 1));
+	delay = delay / 2 + g_random_int_range (0, delay / 2 + 1);
+
+	g_warning ("DockbarX %s, restarting it in %u ms", reason, delay);
+	g_free (reason);
+
+	if (priv->backoff_id > 0)
+		g_source_remove (priv->backoff_id);
+	priv->backoff_id = g_timeout_add (delay, restart_crashed_dockbarx, applet);
+}
+
+static void
+drop_zygote (GooroomDockbarxApplet *applet, const gchar *reason)
+{
+	GooroomDockbarxAppletPrivate *priv = applet->priv;
+
+	g_clear_pointer (&priv->zygote, plug_process_free);
+
+	g_warning ("DockbarX zygote %s, starting DockbarX directly from now on", reason);
+}
+
 static void
-start_dockbarx_done_cb (GPid pid, gint status, gpointer data)
+plug_exited_cb (PlugProcess *process, gint status, gpointer data)
+{
+	GooroomDockbarxApplet *applet = GOOROOM_DOCKBARX_APPLET (data);
+	GooroomDockbarxAppletPrivate *priv = applet->priv;
+
+	/* not the plug's fault, it gets another go without the zygote */
+	if (status == PLUG_PROCESS_STATUS_NOT_FORKED) {
+		if (priv->zygote)
+			drop_zygote (applet, "could not fork a working plug");
+
+		if (process == priv->plug) {
+			g_clear_pointer (&priv->plug, plug_process_free);
+			priv->restarting = FALSE;
+			g_idle_add ((GSourceFunc)start_dockbarx, applet);
+			return;
+		}
+	}
+
+	if (process == priv->standby) {
+		/* the next restart is a cold one again */
+		g_clear_pointer (&priv->standby, plug_process_free);
+		return;
+	}
+
+	if (g_slist_find (priv->stopping, process)) {
+		priv->stopping = g_slist_remove (priv->stopping, process);
+		plug_process_free (process);
+		return;
+	}
+
+	g_clear_pointer (&priv->plug, plug_process_free);
+
+	if (priv->restarting) {
+		priv->restarting = FALSE;
+		g_idle_add ((GSourceFunc)start_dockbarx, applet);
+		return;
+	}
+
+	/* nobody asked it to go */
+	plug_crashed (applet, status);
+}
+
+/* GOOROOM_DOCKBARX_MEMORY_LIMIT caps the plug: in a scope of its own
+ * with MemoryMax where there is a systemd user instance, otherwise with
+ * an address space limit, which is coarse but better than nothing. */
+static gchar *
+get_memory_limit_prefix (guint64 limit)
+{
+	gchar *prefix = NULL;
+	gchar *systemd_run, *prlimit;
+	gchar *systemd_private;
+
+	if (limit == 0)
+		return g_strdup ("");
+
+	systemd_run = g_find_program_in_path ("systemd-run");
+	prlimit = g_find_program_in_path ("prlimit");
+	systemd_private = g_build_filename (g_get_user_runtime_dir (), "systemd", "private", NULL);
+
+	if (systemd_run && g_file_test (systemd_private, G_FILE_TEST_EXISTS)) {
+		/* --scope runs the plug in place, the pid stays ours */
+		prefix = g_strdup_printf ("%s --user --scope --quiet --collect -p MemoryMax=%" G_GUINT64_FORMAT "M -- ",
+                                  systemd_run, limit);
+	} else if (prlimit) {
+		prefix = g_strdup_printf ("%s --as=%" G_GUINT64_FORMAT " -- ",
+                                  prlimit, limit * 1024 * 1024);
+	} else {
+		g_warning ("Neither systemd-run nor prlimit found, DockbarX runs without a memory limit");
+		prefix = g_strdup ("");
+	}
+
+	g_free (systemd_run);
+	g_free (prlimit);
+	g_free (systemd_private);
+
+	return prefix;
+}
+
+static gchar **
+get_dockbarx_argv (GooroomDockbarxApplet *applet, const gchar *args)
 {
-	g_spawn_close_pid (pid);
+	gchar *cmd, *prefix;
+	gchar **argv = NULL;
+	GooroomDockbarxAppletPrivate *priv = applet->priv;
+
+	prefix = get_memory_limit_prefix (priv->memory_limit);
+
+	cmd = g_strdup_printf ("%s/usr/bin/env python3 %s %s", prefix, DOCKBARX_PLUG, args);
+	g_shell_parse_argv (cmd, NULL, &argv, NULL);
+	g_free (cmd);
+	g_free (prefix);
+
+	return argv;
+}
+
+/* Through the zygote when it is up, directly otherwise. */
+static PlugProcess *
+spawn_dockbarx (GooroomDockbarxApplet *applet, const gchar *args, GError **error)
+{
+	gchar **argv;
+	GError *fork_error = NULL;
+	PlugProcess *process;
+	GooroomDockbarxAppletPrivate *priv = applet->priv;
+
+	if (plug_process_is_ready (priv->zygote)) {
+		argv = g_strsplit (args, " ", -1);
+		process = plug_process_spawn_forked (priv->zygote_path, argv,
+                                             plug_exited_cb, plug_event_cb, applet,
+                                             &fork_error);
+		g_strfreev (argv);
+
+		if (process)
+			return process;
+
+		g_warning ("Could not fork DockbarX from the zygote: %s", fork_error->message);
+		g_error_free (fork_error);
+	}
+
+	argv = get_dockbarx_argv (applet, args);
+	process = plug_process_spawn (argv, plug_exited_cb, plug_event_cb, applet, error);
+	g_strfreev (argv);
+
+	return process;
+}
+
+static void
+stop_waiting_for_zygote (GooroomDockbarxApplet *applet)
+{
+	GooroomDockbarxAppletPrivate *priv = applet->priv;
+
+	priv->zygote_waiting = FALSE;
+
+	if (priv->zygote_wait_id > 0) {
+		g_source_remove (priv->zygote_wait_id);
+		priv->zygote_wait_id = 0;
+	}
 }
 
 static gboolean
-start_dockbarx (GooroomDockbarxApplet *applet)
+zygote_timeout_cb (gpointer data)
+{
+	GooroomDockbarxApplet *applet = GOOROOM_DOCKBARX_APPLET (data);
+	GooroomDockbarxAppletPrivate *priv = applet->priv;
+
+	priv->zygote_wait_id = 0;
+	priv->zygote_waiting = FALSE;
+
+	/* a hanging import must not keep the dock blank */
+	drop_zygote (applet, "was not ready in time");
+	start_dockbarx (applet);
+
+	return FALSE;
+}
+
+static void
+zygote_event_cb (PlugProcess *process, const gchar *event, gpointer data)
+{
+	GooroomDockbarxApplet *applet = GOOROOM_DOCKBARX_APPLET (data);
+	GooroomDockbarxAppletPrivate *priv = applet->priv;
+
+	if (g_str_equal (event, "ready") && priv->zygote_waiting) {
+		stop_waiting_for_zygote (applet);
+		start_dockbarx (applet);
+	}
+}
+
+static void
+zygote_exited_cb (PlugProcess *process, gint status, gpointer data)
+{
+	gchar *reason;
+	GooroomDockbarxApplet *applet = GOOROOM_DOCKBARX_APPLET (data);
+	GooroomDockbarxAppletPrivate *priv = applet->priv;
+
+	reason = describe_wait_status (status);
+	drop_zygote (applet, reason);
+	g_free (reason);
+
+	if (priv->zygote_waiting) {
+		stop_waiting_for_zygote (applet);
+		start_dockbarx (applet);
+	}
+}
+
+static void
+start_zygote (GooroomDockbarxApplet *applet)
+{
+	gchar *args;
+	gchar **argv;
+	GError *error = NULL;
+	static guint n_zygotes = 0;
+	const gchar *session = g_getenv ("XDG_SESSION_ID");
+	GooroomDockbarxAppletPrivate *priv = applet->priv;
+
+	if (g_strcmp0 (g_getenv ("GOOROOM_DOCKBARX_ZYGOTE"), "0") == 0)
+		return;
+
+	/* one per session, and per applet should there be several */
+	priv->zygote_path = g_strdup_printf ("%s/gooroom-dockbarx-zygote-%s-%u",
+                                         g_get_user_runtime_dir (),
+                                         session ? session : "0", n_zygotes++);
+
+	/* the memory limit of the zygote would be shared by every plug it
+	 * forks, so they take one of their own along */
+	if (priv->memory_limit > 0)
+		args = g_strdup_printf ("--zygote %s --memory-max %" G_GUINT64_FORMAT,
+                                priv->zygote_path, priv->memory_limit);
+	else
+		args = g_strdup_printf ("--zygote %s", priv->zygote_path);
+	argv = get_dockbarx_argv (applet, args);
+
+	priv->zygote = plug_process_spawn (argv, zygote_exited_cb, zygote_event_cb, applet, &error);
+	if (!priv->zygote) {
+		g_warning ("Could not start the DockbarX zygote: %s", error->message);
+		g_error_free (error);
+	}
+
+	g_strfreev (argv);
+	g_free (args);
+}
+
+static gboolean
+start_standby_dockbarx (gpointer data)
+{
+	GError *error = NULL;
+	GooroomDockbarxApplet *applet = GOOROOM_DOCKBARX_APPLET (data);
+	GooroomDockbarxAppletPrivate *priv = applet->priv;
+
+	priv->standby_id = 0;
+
+	if (priv->standby)
+		return FALSE;
+
+	priv->standby = spawn_dockbarx (applet, "--standby", &error);
+	if (!priv->standby) {
+		g_warning ("Could not start standby DockbarX: %s", error->message);
+		g_error_free (error);
+	}
+
+	return FALSE;
+}
+
+static void
+schedule_standby_dockbarx (GooroomDockbarxApplet *applet)
+{
+	GooroomDockbarxAppletPrivate *priv = applet->priv;
+
+	/* stay out of the way of the plug that is starting up */
+	if (priv->standby_enabled && !priv->standby && priv->standby_id == 0)
+		priv->standby_id = g_timeout_add_seconds (STANDBY_DELAY, start_standby_dockbarx, applet);
+}
+
+static void
+plug_added_cb (GtkSocket *socket, gpointer data)
+{
+	GooroomDockbarxApplet *applet = GOOROOM_DOCKBARX_APPLET (data);
+	GooroomDockbarxAppletPrivate *priv = applet->priv;
+
+	priv->embedded = TRUE;
+
+	mark_stage (applet, STAGE_PLUG_ADDED);
+	check_restart_done (applet);
+}
+
+static gboolean
+plug_removed_cb (GtkSocket *socket, gpointer data)
+{
+	GooroomDockbarxApplet *applet = GOOROOM_DOCKBARX_APPLET (data);
+	GooroomDockbarxAppletPrivate *priv = applet->priv;
+
+	priv->embedded = FALSE;
+
+	/* keep the socket, it is replaced on the next start */
+	return TRUE;
+}
+
+static GtkWidget *
+new_dockbarx_socket (GooroomDockbarxApplet *applet)
 {
-	GPid pid;
-	gchar *cmd = NULL;
-	gchar **argv = NULL, **envp = NULL;
-	gulong socket_id = 0;
 	GooroomDockbarxAppletPrivate *priv = applet->priv;
 
 	if (priv->socket) {
@@ -158,57 +802,109 @@ start_dockbarx (GooroomDockbarxApplet *applet)
 		priv->socket = NULL;
 	}
 
+	/* DockbarX gets another chance */
+	g_clear_pointer (&priv->fallback, gtk_widget_destroy);
+
 	priv->socket = gtk_socket_new ();
 	gtk_container_add (GTK_CONTAINER (applet), priv->socket);
 	gtk_widget_show (GTK_WIDGET (priv->socket));
 
-	socket_id = gtk_socket_get_id (GTK_SOCKET (priv->socket));
+	g_signal_connect (priv->socket, "plug-added", G_CALLBACK (plug_added_cb), applet);
+	g_signal_connect (priv->socket, "plug-removed", G_CALLBACK (plug_removed_cb), applet);
 
-	cmd = g_strdup_printf ("/usr/bin/env python3 %s -s %lu", DOCKBARX_PLUG, socket_id);
+	priv->embedded = FALSE;
 
-	envp = g_get_environ ();
-	g_shell_parse_argv (cmd, NULL, &argv, NULL);
+	return priv->socket;
+}
 
-	if (g_spawn_async (NULL, argv, envp, G_SPAWN_DO_NOT_REAP_CHILD, NULL, NULL, &pid, NULL)) {
-		g_child_watch_add (pid, (GChildWatchFunc) start_dockbarx_done_cb, applet);
+static gboolean
+start_dockbarx (GooroomDockbarxApplet *applet)
+{
+	gchar *args = NULL;
+	gulong socket_id = 0;
+	GError *error = NULL;
+	GtkWidget *socket;
+	GooroomDockbarxAppletPrivate *priv = applet->priv;
+
+	/* the zygote is still importing, it calls back once it is ready */
+	if (plug_process_is_running (priv->zygote) && !plug_process_is_ready (priv->zygote)) {
+		priv->zygote_waiting = TRUE;
+		if (priv->zygote_wait_id == 0)
+			priv->zygote_wait_id = g_timeout_add_seconds (ZYGOTE_TIMEOUT, zygote_timeout_cb, applet);
+		return FALSE;
 	}
 
-	g_timeout_add (500, (GSourceFunc)gooroom_dockbarx_applet_dbus_init_idle, applet);
+	socket = new_dockbarx_socket (applet);
+	socket_id = gtk_socket_get_id (GTK_SOCKET (socket));
 
-	g_free (cmd);
-	g_strfreev (argv);
+	args = g_strdup_printf ("-s %lu", socket_id);
+
+	g_clear_pointer (&priv->plug, plug_process_free);
+
+	priv->plug = spawn_dockbarx (applet, args, &error);
+	if (!priv->plug) {
+		g_warning ("Could not start DockbarX: %s", error->message);
+		g_error_free (error);
+
+		/* no ready to wait for, still allow a Restart */
+		gooroom_dockbarx_applet_dbus_init (applet);
+		plug_crashed (applet, -1);
+	} else {
+		priv->spawn_time = g_get_monotonic_time ();
+		mark_stage (applet, STAGE_PLUG_SPAWN);
+	}
+
+	schedule_standby_dockbarx (applet);
+
+	g_free (args);
 
 	return FALSE;
 }
 
+/* Hands a fresh socket to the standby plug, which only has to embed. */
 static void
-kill_dockbarx_done_cb (GPid pid, gint status, gpointer data)
+swap_dockbarx (GooroomDockbarxApplet *applet)
 {
-	GooroomDockbarxApplet *applet = GOOROOM_DOCKBARX_APPLET (data);
+	gchar *command;
+	GtkWidget *socket;
 	GooroomDockbarxAppletPrivate *priv = applet->priv;
 
-	g_spawn_close_pid (pid);
+	/* plugs still being stopped from before keep their SIGKILL */
+	if (priv->plug) {
+		plug_process_stop (priv->plug, PLUG_STOP_TIMEOUT);
+		priv->stopping = g_slist_prepend (priv->stopping, priv->plug);
+	}
 
-	g_idle_add ((GSourceFunc)start_dockbarx, applet);
+	priv->plug = priv->standby;
+	priv->standby = NULL;
+	priv->spawn_time = g_get_monotonic_time ();
+
+	socket = new_dockbarx_socket (applet);
+
+	command = g_strdup_printf ("embed %lu", gtk_socket_get_id (GTK_SOCKET (socket)));
+	plug_process_send (priv->plug, command);
+	g_free (command);
+
+	schedule_standby_dockbarx (applet);
 }
 
 static void
 kill_dockbarx (GooroomDockbarxApplet *applet)
 {
-	GPid pid;
-	gchar **argv = NULL, **envp = NULL;
 	GooroomDockbarxAppletPrivate *priv = applet->priv;
 
-	envp = g_get_environ ();
-	g_shell_parse_argv ("/usr/bin/pkill -f 'python.*xfce4-dockbarx-plug'", NULL, &argv, NULL);
+	if (plug_process_is_running (priv->standby)) {
+		swap_dockbarx (applet);
+		return;
+	}
 
-	if (g_spawn_async (NULL, argv, envp, G_SPAWN_DO_NOT_REAP_CHILD, NULL, NULL, &pid, NULL)) {
-		g_child_watch_add (pid, (GChildWatchFunc) kill_dockbarx_done_cb, applet);
+	/* start again once the old plug has been reaped */
+	if (plug_process_is_running (priv->plug)) {
+		priv->restarting = TRUE;
+		plug_process_stop (priv->plug, PLUG_STOP_TIMEOUT);
 	} else {
 		g_idle_add ((GSourceFunc)start_dockbarx, applet);
 	}
-
-	g_strfreev (argv);
 }
 
 static gboolean
@@ -228,32 +924,201 @@ restart_dockbarx_idle (gpointer data)
 }
 
 static void
-update_launchers (void)
+schedule_restart (GooroomDockbarxApplet *applet)
 {
-	g_spawn_command_line_sync (GOOROOM_UPDATE_LAUNCHERS_HELPER, NULL, NULL, NULL, NULL);
+	GooroomDockbarxAppletPrivate *priv = applet->priv;
+
+	if (priv->timeout_id == 0) {
+		priv->restart_time = g_get_monotonic_time ();
+		priv->timeout_id = g_idle_add ((GSourceFunc)restart_dockbarx_idle, applet);
+	}
 }
 
+/* Without an idle monitor there is no telling whether the user is at the
+ * dock, so a grown plug is left alone for RECYCLE_POSTPONE samples in a
+ * row before it is replaced anyway. */
 static void
-init_thread_done_cb (GObject      *source_object,
-                     GAsyncResult *result,
-                     gpointer      user_data)
+postpone_recycle (GooroomDockbarxApplet *applet)
 {
-	GooroomDockbarxApplet *applet = GOOROOM_DOCKBARX_APPLET (user_data);
 	GooroomDockbarxAppletPrivate *priv = applet->priv;
 
-	g_idle_add ((GSourceFunc)start_dockbarx, applet);
+	if (++priv->recycle_waits < RECYCLE_POSTPONE)
+		return;
+
+	g_message ("Recycling DockbarX at %" G_GUINT64_FORMAT " MiB without an idle time",
+               priv->plug_rss / (1024 * 1024));
+
+	priv->recycle_waits = 0;
+	schedule_restart (applet);
 }
 
 static void
-start_init_thread (GTask        *task,
-                   gpointer      source_object,
-                   gpointer      task_data,
-                   GCancellable *cancellable)
+idle_time_cb (GObject      *source_object,
+              GAsyncResult *res,
+              gpointer      user_data)
 {
-	update_launchers ();
+	GVariant *ret;
+	guint64 idle_time = G_MAXUINT64;
+	GError *error = NULL;
+	GooroomDockbarxApplet *applet;
+	GooroomDockbarxAppletPrivate *priv;
+
+	ret = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source_object), res, &error);
+	if (ret) {
+		g_variant_get (ret, "(t)", &idle_time);
+		g_variant_unref (ret);
+	} else if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+		/* the applet is gone */
+		g_error_free (error);
+		return;
+	} else {
+		g_debug ("Could not get the idle time: %s", error->message);
+		g_error_free (error);
+	}
+
+	applet = GOOROOM_DOCKBARX_APPLET (user_data);
+	priv = applet->priv;
+
+	priv->recycling = FALSE;
 
-	/* The task has finished */
-	g_task_return_boolean (task, TRUE);
+	if (!ret) {
+		postpone_recycle (applet);
+		return;
+	}
+
+	/* try again with the next sample */
+	if (idle_time < RECYCLE_IDLE_TIME * 1000)
+		return;
+
+	g_message ("Recycling DockbarX at %" G_GUINT64_FORMAT " MiB", priv->plug_rss / (1024 * 1024));
+
+	schedule_restart (applet);
+}
+
+/* Replaces a grown plug once the user has stepped away. */
+static void
+recycle_dockbarx (GooroomDockbarxApplet *applet)
+{
+	GooroomDockbarxAppletPrivate *priv = applet->priv;
+
+	if (priv->recycling || priv->timeout_id > 0)
+		return;
+
+	if (!priv->connection) {
+		postpone_recycle (applet);
+		return;
+	}
+
+	priv->recycling = TRUE;
+
+	g_dbus_connection_call (priv->connection,
+                            "org.gnome.Mutter.IdleMonitor",
+                            "/org/gnome/Mutter/IdleMonitor/Core",
+                            "org.gnome.Mutter.IdleMonitor",
+                            "GetIdletime",
+                            NULL,
+                            G_VARIANT_TYPE ("(t)"),
+                            G_DBUS_CALL_FLAGS_NONE,
+                            -1,
+                            priv->cancellable,
+                            idle_time_cb,
+                            applet);
+}
+
+static gboolean
+watchdog_cb (gpointer data)
+{
+	GPid pid;
+	guint64 rss, cpu_time;
+	GooroomDockbarxApplet *applet = GOOROOM_DOCKBARX_APPLET (data);
+	GooroomDockbarxAppletPrivate *priv = applet->priv;
+
+	if (!plug_process_is_running (priv->plug) ||
+        !plug_process_get_usage (priv->plug, &rss, &cpu_time))
+		return TRUE;
+
+	/* a busy loop, not a busy user */
+	pid = plug_process_get_pid (priv->plug);
+	if (pid == priv->sample_pid &&
+        cpu_time - priv->plug_cpu_time > (guint64) WATCHDOG_INTERVAL * G_USEC_PER_SEC * WATCHDOG_CPU_WARN / 100) {
+		g_warning ("DockbarX used %" G_GUINT64_FORMAT "%% of a CPU over the last %d seconds",
+                   (cpu_time - priv->plug_cpu_time) * 100 / ((guint64) WATCHDOG_INTERVAL * G_USEC_PER_SEC),
+                   WATCHDOG_INTERVAL);
+	}
+
+	priv->sample_pid    = pid;
+	priv->plug_rss      = rss;
+	priv->plug_cpu_time = cpu_time;
+
+	if (priv->recycle_rss > 0 && rss > priv->recycle_rss * 1024 * 1024)
+		recycle_dockbarx (applet);
+	else
+		priv->recycle_waits = 0;
+
+	return TRUE;
+}
+
+static guint64
+get_env_mib (const gchar *variable, guint64 fallback)
+{
+	const gchar *value = g_getenv (variable);
+
+	if (!value || *value == '\0')
+		return fallback;
+
+	return g_ascii_strtoull (value, NULL, 10);
+}
+
+static void
+sync_launchers_progress_cb (LauncherSyncEvent         event,
+                            const gchar              *desktop_file,
+                            const LauncherSyncResult *progress,
+                            gpointer                  user_data)
+{
+	gchar *command;
+	GooroomDockbarxApplet *applet = GOOROOM_DOCKBARX_APPLET (user_data);
+
+	switch (event) {
+	case LAUNCHER_SYNC_EVENT_PUBLISHED:
+		/* the plug came up with the launchers of the last sync,
+		 * hand it the new ones in place */
+		if (!progress->unchanged)
+			send_dockbarx_command (applet, "reload-launchers");
+		break;
+	case LAUNCHER_SYNC_EVENT_ICON_CHANGED:
+		command = g_strdup_printf ("update-icon %s", desktop_file);
+		send_dockbarx_command (applet, command);
+		g_free (command);
+		break;
+	default:
+		break;
+	}
+}
+
+static void
+sync_launchers_done_cb (const LauncherSyncResult *result,
+                        const GError             *error,
+                        gpointer                  user_data)
+{
+	GooroomDockbarxApplet *applet = GOOROOM_DOCKBARX_APPLET (user_data);
+	GooroomDockbarxAppletPrivate *priv = applet->priv;
+
+	if (!result) {
+		/* without a policy DockbarX simply keeps whatever it has */
+		if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT))
+			g_message ("%s", error->message);
+		else
+			g_warning ("Could not sync launchers: %s", error->message);
+
+		mark_stage (applet, STAGE_SYNC_END);
+		return;
+	}
+
+	priv->sync_result = *result;
+	priv->synced = TRUE;
+
+	launcher_sync_result_log (result);
+	mark_stage (applet, STAGE_SYNC_END);
 }
 
 
@@ -271,9 +1136,16 @@ handle_method_call (GDBusConnection *conn,
 	GooroomDockbarxAppletPrivate *priv = applet->priv;
 
 	if (!g_strcmp0 (method_name, "Restart")) {
-		if (priv->timeout_id == 0)
-			priv->timeout_id = g_idle_add ((GSourceFunc)restart_dockbarx_idle, applet);
+		/* also the way out of the fallback, with a clean slate */
+		priv->crashes = 0;
+		if (priv->backoff_id > 0) {
+			g_source_remove (priv->backoff_id);
+			priv->backoff_id = 0;
+		}
+		schedule_restart (applet);
 		g_dbus_method_invocation_return_value (invocation, g_variant_new ("()"));
+	} else if (!g_strcmp0 (method_name, "GetTimings")) {
+		g_dbus_method_invocation_return_value (invocation, get_timings (applet));
 	} else {
 		g_dbus_method_invocation_return_error (invocation,
                                                G_DBUS_ERROR,
@@ -282,6 +1154,45 @@ handle_method_call (GDBusConnection *conn,
 	}
 }
 
+static GVariant *
+handle_get_property (GDBusConnection *conn,
+                     const gchar *sender,
+                     const gchar *object_path,
+                     const gchar *interface_name,
+                     const gchar *property_name,
+                     GError **error,
+                     gpointer data)
+{
+	GooroomDockbarxApplet *applet = GOOROOM_DOCKBARX_APPLET (data);
+	GooroomDockbarxAppletPrivate *priv = applet->priv;
+
+	if (!g_strcmp0 (property_name, "RestartLatency"))
+		return g_variant_new_int64 (priv->restart_latency);
+
+	if (!g_strcmp0 (property_name, "CrashCount"))
+		return g_variant_new_uint32 (priv->n_crashes);
+
+	if (!g_strcmp0 (property_name, "ExitStatuses"))
+		return g_variant_new_fixed_array (G_VARIANT_TYPE_INT32,
+                                          priv->exit_statuses->data,
+                                          priv->exit_statuses->len,
+                                          sizeof (gint));
+
+	if (!g_strcmp0 (property_name, "Fallback"))
+		return g_variant_new_boolean (priv->fallback != NULL);
+
+	if (!g_strcmp0 (property_name, "PlugRss"))
+		return g_variant_new_uint64 (priv->plug_rss);
+
+	if (!g_strcmp0 (property_name, "PlugCpuTime"))
+		return g_variant_new_uint64 (priv->plug_cpu_time);
+
+	g_set_error (error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_PROPERTY,
+                 "No such property: %s", property_name);
+
+	return NULL;
+}
+
 //static gboolean
 //set_max_size_cb (gpointer data)
 //{
@@ -319,14 +1230,55 @@ handle_method_call (GDBusConnection *conn,
 //	g_timeout_add (100, (GSourceFunc)set_max_size_cb, gp_applet);
 //}
 
+static gboolean
+monitors_settled_cb (gpointer data)
+{
+	gchar *command;
+	gint max_size = 32767;
+	GtkOrientation orientation;
+	GooroomDockbarxApplet *applet = GOOROOM_DOCKBARX_APPLET (data);
+	GooroomDockbarxAppletPrivate *priv = applet->priv;
+
+	priv->monitors_id = 0;
+
+	if (priv->dockbarx_settings)
+		max_size = g_settings_get_int (priv->dockbarx_settings, "max-size");
+
+	orientation = gp_applet_get_orientation (GP_APPLET (applet));
+
+	if (priv->fallback) {
+		gtk_orientable_set_orientation (GTK_ORIENTABLE (priv->fallback), orientation);
+		return FALSE;
+	}
+
+	command = g_strdup_printf ("relayout %d %s", max_size,
+                               (orientation == GTK_ORIENTATION_HORIZONTAL) ? "h" : "v");
+
+	/* a plug that cannot be told is replaced instead, unless a
+	 * crashed one is about to come back anyway */
+	if (!plug_process_is_running (priv->plug) || !plug_process_send (priv->plug, command)) {
+		if (priv->backoff_id == 0)
+			schedule_restart (applet);
+	}
+
+	if (plug_process_is_running (priv->standby))
+		plug_process_send (priv->standby, command);
+
+	g_free (command);
+
+	return FALSE;
+}
+
 static void
 monitors_changed_cb (GdkScreen *screen, gpointer data)
 {
 	GooroomDockbarxApplet *applet = GOOROOM_DOCKBARX_APPLET (data);
 	GooroomDockbarxAppletPrivate *priv = applet->priv;
 
-	if (priv->timeout_id == 0)
-		priv->timeout_id = g_idle_add ((GSourceFunc)restart_dockbarx_idle, applet);
+	/* docking a laptop comes with a burst of these */
+	if (priv->monitors_id > 0)
+		g_source_remove (priv->monitors_id);
+	priv->monitors_id = g_timeout_add (MONITORS_SETTLE_DELAY, monitors_settled_cb, applet);
 }
 
 static void
@@ -340,6 +1292,42 @@ gooroom_dockbarx_applet_finalize (GObject *object)
 		priv->timeout_id = 0;
 	}
 
+	if (priv->standby_id > 0) {
+		g_source_remove (priv->standby_id);
+		priv->standby_id = 0;
+	}
+
+	if (priv->monitors_id > 0) {
+		g_source_remove (priv->monitors_id);
+		priv->monitors_id = 0;
+	}
+
+	if (priv->backoff_id > 0) {
+		g_source_remove (priv->backoff_id);
+		priv->backoff_id = 0;
+	}
+
+	if (priv->watchdog_id > 0) {
+		g_source_remove (priv->watchdog_id);
+		priv->watchdog_id = 0;
+	}
+
+	if (priv->zygote_wait_id > 0) {
+		g_source_remove (priv->zygote_wait_id);
+		priv->zygote_wait_id = 0;
+	}
+
+	g_signal_handlers_disconnect_by_func (gdk_screen_get_default (),
+                                          monitors_changed_cb, applet);
+
+	/* a running sync is cancelled and winds down on its own */
+	g_clear_pointer (&priv->sync_watch, launcher_sync_watch_free);
+
+	if (priv->cancellable) {
+		g_cancellable_cancel (priv->cancellable);
+		g_object_unref (priv->cancellable);
+	}
+
 	if (priv->owner_id) {
 		g_bus_unown_name (priv->owner_id);
 		priv->owner_id = 0;
@@ -353,6 +1341,20 @@ gooroom_dockbarx_applet_finalize (GObject *object)
 	if (priv->dockbarx_settings)
 		g_object_unref (priv->dockbarx_settings);
 
+	g_clear_pointer (&priv->plug, plug_process_free);
+	g_clear_pointer (&priv->standby, plug_process_free);
+	g_slist_free_full (priv->stopping, (GDestroyNotify)plug_process_free);
+	priv->stopping = NULL;
+
+	g_array_free (priv->exit_statuses, TRUE);
+
+	/* after the plugs, which it may have forked */
+	g_clear_pointer (&priv->zygote, plug_process_free);
+	if (priv->zygote_path) {
+		g_unlink (priv->zygote_path);
+		g_free (priv->zygote_path);
+	}
+
 	if (G_OBJECT_CLASS (gooroom_dockbarx_applet_parent_class)->finalize)
 		G_OBJECT_CLASS (gooroom_dockbarx_applet_parent_class)->finalize (object);
 }
@@ -360,11 +1362,19 @@ gooroom_dockbarx_applet_finalize (GObject *object)
 static gboolean
 gooroom_dockbarx_applet_fill (GooroomDockbarxApplet *applet)
 {
-	GTask *task;
+	GooroomDockbarxAppletPrivate *priv = applet->priv;
+
+	/* the first plug is forked from it already */
+	start_zygote (applet);
 
-	task = g_task_new (NULL, NULL, init_thread_done_cb, applet);
-	g_task_run_in_thread (task, start_init_thread);
-	g_object_unref (task);
+	/* do not keep the dock waiting for the network */
+	g_idle_add ((GSourceFunc)start_dockbarx, applet);
+
+	/* the login agent may still be writing the policy */
+	mark_stage (applet, STAGE_SYNC_START);
+	priv->sync_watch = launcher_sync_watch_new (POLICY_TIMEOUT, FALSE,
+                                                sync_launchers_progress_cb, applet,
+                                                sync_launchers_done_cb, applet);
 
 	return TRUE;
 }
@@ -387,6 +1397,8 @@ gooroom_dockbarx_applet_init (GooroomDockbarxApplet *applet)
 
 	priv = applet->priv = gooroom_dockbarx_applet_get_instance_private (applet);
 
+	priv->stage_time[STAGE_APPLET_INIT] = g_get_monotonic_time ();
+
 	gp_applet_set_flags (GP_APPLET (applet),
                          GP_APPLET_FLAGS_EXPAND_MAJOR |
                          GP_APPLET_FLAGS_EXPAND_MINOR);
@@ -399,10 +1411,40 @@ gooroom_dockbarx_applet_init (GooroomDockbarxApplet *applet)
 		g_settings_schema_unref (schema);
 	}
 
-	priv->socket     = NULL;
-	priv->reg_id     = 0;
-	priv->owner_id   = 0;
-	priv->timeout_id = 0;
+	priv->socket          = NULL;
+	priv->cancellable     = g_cancellable_new ();
+	priv->plug            = NULL;
+	priv->restarting      = FALSE;
+	priv->embedded        = FALSE;
+	priv->restart_time    = 0;
+	priv->restart_latency = -1;
+	priv->standby_enabled = (g_strcmp0 (g_getenv ("GOOROOM_DOCKBARX_STANDBY"), "1") == 0);
+	priv->standby         = NULL;
+	priv->stopping        = NULL;
+	priv->standby_id      = 0;
+	priv->reg_id          = 0;
+	priv->owner_id        = 0;
+	priv->timeout_id      = 0;
+	priv->monitors_id     = 0;
+	priv->spawn_time      = 0;
+	priv->crashes         = 0;
+	priv->n_crashes       = 0;
+	priv->exit_statuses   = g_array_new (FALSE, FALSE, sizeof (gint));
+	priv->backoff_id      = 0;
+	priv->fallback        = NULL;
+	priv->sync_watch      = NULL;
+	priv->sample_pid      = 0;
+	priv->plug_rss        = 0;
+	priv->plug_cpu_time   = 0;
+	priv->recycling       = FALSE;
+	priv->recycle_waits   = 0;
+	priv->recycle_rss     = get_env_mib ("GOOROOM_DOCKBARX_RECYCLE_RSS", RECYCLE_RSS);
+	priv->memory_limit    = get_env_mib ("GOOROOM_DOCKBARX_MEMORY_LIMIT", 0);
+	priv->zygote          = NULL;
+	priv->zygote_path     = NULL;
+	priv->zygote_waiting  = FALSE;
+	priv->zygote_wait_id   = 0;
+	priv->watchdog_id     = g_timeout_add_seconds (WATCHDOG_INTERVAL, watchdog_cb, applet);
 
 	screen = gdk_screen_get_default ();
 
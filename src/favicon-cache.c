@@ -0,0 +1,362 @@
+/*
+ * Copyright (C) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "favicon-cache.h"
+
+#define INDEX_FILE	"favicons.index"
+#define BLOB_DIR	"favicons"
+
+#define KEY_URL				"URL"
+#define KEY_HASH			"Hash"
+#define KEY_ETAG			"ETag"
+#define KEY_LAST_MODIFIED	"Last-Modified"
+#define KEY_CHECKED			"Checked"
+#define KEY_USED			"Used"
+
+
+struct _FaviconCache
+{
+	gchar    *blob_dir;
+	gchar    *index_file;
+	GKeyFile *index;
+
+	gint64    now;
+	gboolean  dirty;
+};
+
+typedef struct
+{
+	gchar  *group;
+	gchar  *hash;
+	gint64  used;
+} CacheEntry;
+
+
+/* urls are not valid GKeyFile group names, so groups are named after
+ * the checksum of the url and the url itself is kept as a key */
+static gchar *
+entry_group (const gchar *url)
+{
+	return g_compute_checksum_for_string (G_CHECKSUM_SHA1, url, -1);
+}
+
+static gchar *
+entry_blob_path (FaviconCache *cache, const gchar *group)
+{
+	gchar *hash, *path = NULL;
+
+	hash = g_key_file_get_string (cache->index, group, KEY_HASH, NULL);
+	if (hash) {
+		path = g_build_filename (cache->blob_dir, hash, NULL);
+		if (!g_file_test (path, G_FILE_TEST_IS_REGULAR)) {
+			g_free (path);
+			path = NULL;
+		}
+	}
+
+	g_free (hash);
+
+	return path;
+}
+
+static void
+entry_set_string (FaviconCache *cache, const gchar *group, const gchar *key, const gchar *value)
+{
+	if (value)
+		g_key_file_set_string (cache->index, group, key, value);
+	else
+		g_key_file_remove_key (cache->index, group, key, NULL);
+}
+
+static void
+cache_entry_free (CacheEntry *entry)
+{
+	g_free (entry->group);
+	g_free (entry->hash);
+	g_free (entry);
+}
+
+static gint
+cache_entry_compare_used (gconstpointer a, gconstpointer b)
+{
+	const CacheEntry *ea = a, *eb = b;
+
+	return (ea->used > eb->used) - (ea->used < eb->used);
+}
+
+FaviconCache *
+favicon_cache_new (const gchar *cache_dir)
+{
+	g_return_val_if_fail (cache_dir != NULL, NULL);
+
+	FaviconCache *cache = g_new0 (FaviconCache, 1);
+
+	cache->blob_dir   = g_build_filename (cache_dir, BLOB_DIR, NULL);
+	cache->index_file = g_build_filename (cache_dir, INDEX_FILE, NULL);
+	cache->index      = g_key_file_new ();
+	cache->now        = g_get_real_time () / G_USEC_PER_SEC;
+
+	g_mkdir_with_parents (cache->blob_dir, 0700);
+	g_key_file_load_from_file (cache->index, cache->index_file, G_KEY_FILE_NONE, NULL);
+
+	return cache;
+}
+
+void
+favicon_cache_free (FaviconCache *cache)
+{
+	if (!cache)
+		return;
+
+	g_key_file_free (cache->index);
+	g_free (cache->blob_dir);
+	g_free (cache->index_file);
+	g_free (cache);
+}
+
+gboolean
+favicon_cache_save (FaviconCache *cache)
+{
+	g_return_val_if_fail (cache != NULL, FALSE);
+
+	if (!cache->dirty)
+		return TRUE;
+
+	if (!g_key_file_save_to_file (cache->index, cache->index_file, NULL))
+		return FALSE;
+
+	cache->dirty = FALSE;
+
+	return TRUE;
+}
+
+gboolean
+favicon_cache_is_fresh (FaviconCache *cache, const gchar *url, gint64 ttl)
+{
+	gchar *group, *path;
+	gboolean ret = FALSE;
+
+	group = entry_group (url);
+	path = entry_blob_path (cache, group);
+
+	if (path) {
+		gint64 checked = g_key_file_get_int64 (cache->index, group, KEY_CHECKED, NULL);
+		ret = (cache->now - checked) < ttl;
+	}
+
+	g_free (group);
+	g_free (path);
+
+	return ret;
+}
+
+void
+favicon_cache_get_validators (FaviconCache *cache,
+                              const gchar  *url,
+                              gchar       **etag,
+                              gchar       **last_modified)
+{
+	gchar *group, *path;
+
+	*etag = *last_modified = NULL;
+
+	group = entry_group (url);
+	path = entry_blob_path (cache, group);
+
+	/* validators are useless once the content is gone */
+	if (path) {
+		*etag = g_key_file_get_string (cache->index, group, KEY_ETAG, NULL);
+		*last_modified = g_key_file_get_string (cache->index, group, KEY_LAST_MODIFIED, NULL);
+	}
+
+	g_free (group);
+	g_free (path);
+}
+
+gchar *
+favicon_cache_store (FaviconCache *cache,
+                     const gchar  *url,
+                     GBytes       *data,
+                     const gchar  *etag,
+                     const gchar  *last_modified)
+{
+	gsize size = 0;
+	gconstpointer contents;
+	gchar *hash, *group, *path;
+
+	g_return_val_if_fail (data != NULL, NULL);
+
+	hash = g_compute_checksum_for_bytes (G_CHECKSUM_SHA256, data);
+	path = g_build_filename (cache->blob_dir, hash, NULL);
+
+	if (!g_file_test (path, G_FILE_TEST_IS_REGULAR)) {
+		contents = g_bytes_get_data (data, &size);
+		if (!g_file_set_contents (path, contents, size, NULL)) {
+			g_free (hash);
+			g_free (path);
+			return NULL;
+		}
+	}
+
+	group = entry_group (url);
+
+	g_key_file_set_string (cache->index, group, KEY_URL, url);
+	g_key_file_set_string (cache->index, group, KEY_HASH, hash);
+	entry_set_string (cache, group, KEY_ETAG, etag);
+	entry_set_string (cache, group, KEY_LAST_MODIFIED, last_modified);
+	g_key_file_set_int64 (cache->index, group, KEY_CHECKED, cache->now);
+	g_key_file_set_int64 (cache->index, group, KEY_USED, cache->now);
+
+	cache->dirty = TRUE;
+
+	g_free (hash);
+	g_free (group);
+
+	return path;
+}
+
+void
+favicon_cache_revalidated (FaviconCache *cache, const gchar *url)
+{
+	gchar *group = entry_group (url);
+
+	if (g_key_file_has_group (cache->index, group)) {
+		g_key_file_set_int64 (cache->index, group, KEY_CHECKED, cache->now);
+		cache->dirty = TRUE;
+	}
+
+	g_free (group);
+}
+
+void
+favicon_cache_remove (FaviconCache *cache, const gchar *url)
+{
+	gchar *group = entry_group (url);
+
+	if (g_key_file_remove_group (cache->index, group, NULL))
+		cache->dirty = TRUE;
+
+	g_free (group);
+}
+
+gchar *
+favicon_cache_lookup (FaviconCache *cache, const gchar *url)
+{
+	gchar *group, *path;
+
+	group = entry_group (url);
+	path = entry_blob_path (cache, group);
+
+	if (path) {
+		g_key_file_set_int64 (cache->index, group, KEY_USED, cache->now);
+		cache->dirty = TRUE;
+	}
+
+	g_free (group);
+
+	return path;
+}
+
+void
+favicon_cache_gc (FaviconCache *cache, gint64 max_age, goffset max_size)
+{
+	GDir *dir;
+	goffset total = 0;
+	GList *entries = NULL, *l = NULL;
+	GHashTable *refs, *sizes;
+	gchar **groups;
+	guint i;
+
+	refs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	sizes = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	/* expire entries that have not been used for a while */
+	groups = g_key_file_get_groups (cache->index, NULL);
+	for (i = 0; groups[i] != NULL; i++) {
+		gint64 used = g_key_file_get_int64 (cache->index, groups[i], KEY_USED, NULL);
+		gchar *hash = g_key_file_get_string (cache->index, groups[i], KEY_HASH, NULL);
+
+		if (!hash || (cache->now - used) > max_age) {
+			g_key_file_remove_group (cache->index, groups[i], NULL);
+			cache->dirty = TRUE;
+			g_free (hash);
+			continue;
+		}
+
+		CacheEntry *entry = g_new0 (CacheEntry, 1);
+		entry->group = g_strdup (groups[i]);
+		entry->hash  = hash;
+		entry->used  = used;
+		entries = g_list_prepend (entries, entry);
+
+		guint ref = GPOINTER_TO_UINT (g_hash_table_lookup (refs, hash));
+		g_hash_table_insert (refs, g_strdup (hash), GUINT_TO_POINTER (ref + 1));
+	}
+	g_strfreev (groups);
+
+	/* drop files nobody points to and sum up the rest */
+	dir = g_dir_open (cache->blob_dir, 0, NULL);
+	if (dir) {
+		const gchar *name;
+		while ((name = g_dir_read_name (dir)) != NULL) {
+			GStatBuf st;
+			gchar *path = g_build_filename (cache->blob_dir, name, NULL);
+
+			if (!g_hash_table_contains (refs, name)) {
+				g_unlink (path);
+			} else if (g_stat (path, &st) == 0) {
+				g_hash_table_insert (sizes, g_strdup (name), GSIZE_TO_POINTER (st.st_size));
+				total += st.st_size;
+			}
+
+			g_free (path);
+		}
+		g_dir_close (dir);
+	}
+
+	/* evict least recently used entries, but never those used by this run */
+	entries = g_list_sort (entries, cache_entry_compare_used);
+	for (l = entries; l && total > max_size; l = l->next) {
+		CacheEntry *entry = (CacheEntry *)l->data;
+		guint ref;
+
+		if (entry->used >= cache->now)
+			break;
+
+		g_key_file_remove_group (cache->index, entry->group, NULL);
+		cache->dirty = TRUE;
+
+		ref = GPOINTER_TO_UINT (g_hash_table_lookup (refs, entry->hash)) - 1;
+		g_hash_table_insert (refs, g_strdup (entry->hash), GUINT_TO_POINTER (ref));
+
+		if (ref == 0 && g_hash_table_contains (sizes, entry->hash)) {
+			gchar *path = g_build_filename (cache->blob_dir, entry->hash, NULL);
+			g_unlink (path);
+			g_free (path);
+
+			total -= GPOINTER_TO_SIZE (g_hash_table_lookup (sizes, entry->hash));
+		}
+	}
+
+	g_list_free_full (entries, (GDestroyNotify) cache_entry_free);
+	g_hash_table_destroy (refs);
+	g_hash_table_destroy (sizes);
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __FAVICON_CACHE_H__
+#define __FAVICON_CACHE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Entries are keyed by url and point to a file named after the sha256 of
+ * its content, so identical icons are stored once. */
+typedef struct _FaviconCache FaviconCache;
+
+FaviconCache *favicon_cache_new              (const gchar  *cache_dir);
+void          favicon_cache_free             (FaviconCache *cache);
+gboolean      favicon_cache_save             (FaviconCache *cache);
+
+gboolean      favicon_cache_is_fresh         (FaviconCache *cache,
+                                              const gchar  *url,
+                                              gint64        ttl);
+void          favicon_cache_get_validators   (FaviconCache *cache,
+                                              const gchar  *url,
+                                              gchar       **etag,
+                                              gchar       **last_modified);
+
+gchar        *favicon_cache_store            (FaviconCache *cache,
+                                              const gchar  *url,
+                                              GBytes       *data,
+                                              const gchar  *etag,
+                                              const gchar  *last_modified);
+void          favicon_cache_revalidated      (FaviconCache *cache,
+                                              const gchar  *url);
+void          favicon_cache_remove           (FaviconCache *cache,
+                                              const gchar  *url);
+
+gchar        *favicon_cache_lookup           (FaviconCache *cache,
+                                              const gchar  *url);
+
+void          favicon_cache_gc               (FaviconCache *cache,
+                                              gint64        max_age,
+                                              goffset       max_size);
+
+G_END_DECLS
+
+#endif /* __FAVICON_CACHE_H__ */
@@ -0,0 +1,396 @@
+/*
+ * Copyright (C) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <glib.h>
+#include <gio/gio.h>
+#include <libsoup/soup.h>
+
+#include "favicon-fetcher.h"
+
+#define FETCH_MAX_RETRY			2
+#define FETCH_RETRY_DELAY		250 /* ms, doubled on every retry */
+#define FETCH_MAX_CONNS_PER_HOST	2
+
+
+struct _FaviconFetcher
+{
+	SoupSession *session;
+	GMainLoop   *loop;
+	GQueue       pending;
+	GList       *running;
+	gboolean     cancelled;
+
+	guint        active;
+	guint        max_concurrent;
+	guint        timeout_ms;
+};
+
+typedef struct
+{
+	FaviconFetcher     *fetcher;
+	gchar              *url;
+	gchar              *etag;
+	gchar              *last_modified;
+	/* the host the policy named, see accept_certificate_cb() */
+	gchar              *host;
+	SoupMessage        *msg;
+	GCancellable       *cancellable;
+	gint64              deadline;
+	guint               timeout_id;
+	guint               retry;
+	guint               retry_id;
+
+	FaviconFetcherFunc  func;
+	gpointer            user_data;
+	GDestroyNotify      destroy;
+} FetchJob;
+
+
+static void     fetch_job_done_cb    (GObject      *source_object,
+                                      GAsyncResult *result,
+                                      gpointer      user_data);
+static gboolean fetch_job_timeout_cb (gpointer      user_data);
+
+static void
+fetcher_remove_source (FaviconFetcher *fetcher, guint id)
+{
+	GMainContext *context = g_main_loop_get_context (fetcher->loop);
+	GSource *source = g_main_context_find_source_by_id (context, id);
+
+	if (source)
+		g_source_destroy (source);
+}
+
+static void
+fetch_job_free (FetchJob *job)
+{
+	if (job->timeout_id > 0)
+		fetcher_remove_source (job->fetcher, job->timeout_id);
+	if (job->retry_id > 0)
+		fetcher_remove_source (job->fetcher, job->retry_id);
+
+	if (job->destroy)
+		job->destroy (job->user_data);
+
+	g_clear_object (&job->msg);
+	g_clear_object (&job->cancellable);
+	g_free (job->url);
+	g_free (job->etag);
+	g_free (job->last_modified);
+	g_free (job->host);
+	g_free (job);
+}
+
+static void
+fetch_job_finish (FetchJob *job, guint status, GBytes *body)
+{
+	FaviconFetchResult result = { 0, };
+
+	result.status = status;
+	result.cancelled = (status == 0 && job->fetcher->cancelled);
+	result.body = SOUP_STATUS_IS_SUCCESSFUL (status) ? body : NULL;
+
+	if (status != 0 && job->msg) {
+		SoupMessageHeaders *headers = soup_message_get_response_headers (job->msg);
+		result.etag = soup_message_headers_get_one (headers, "ETag");
+		result.last_modified = soup_message_headers_get_one (headers, "Last-Modified");
+	}
+
+	if (job->func)
+		job->func (job->url, &result, job->user_data);
+
+	fetch_job_free (job);
+}
+
+/* Favicons used to be fetched with 'wget --no-check-certificate', and
+ * policies point at intranet servers with self-signed certificates. Those
+ * are still accepted, but only from the host the policy named; wherever
+ * it redirects to has to present a valid certificate. */
+static gboolean
+accept_certificate_cb (SoupMessage          *msg,
+                       GTlsCertificate      *certificate,
+                       GTlsCertificateFlags  errors,
+                       gpointer              user_data)
+{
+	FetchJob *job = (FetchJob *)user_data;
+	const gchar *host = g_uri_get_host (soup_message_get_uri (msg));
+
+	return (job->host && host && g_ascii_strcasecmp (job->host, host) == 0);
+}
+
+static guint
+fetcher_add_timeout (FaviconFetcher *fetcher, guint timeout_ms,
+                     GSourceFunc func, FetchJob *job)
+{
+	guint id;
+	GSource *source;
+
+	source = g_timeout_source_new (timeout_ms);
+	g_source_set_callback (source, func, job, NULL);
+	id = g_source_attach (source, g_main_loop_get_context (fetcher->loop));
+	g_source_unref (source);
+
+	return id;
+}
+
+static gboolean
+fetch_job_send (FetchJob *job)
+{
+	g_clear_object (&job->msg);
+
+	job->msg = soup_message_new (SOUP_METHOD_GET, job->url);
+	if (!job->msg)
+		return FALSE;
+
+	if (!job->host)
+		job->host = g_strdup (g_uri_get_host (soup_message_get_uri (job->msg)));
+
+	g_signal_connect (job->msg, "accept-certificate",
+                      G_CALLBACK (accept_certificate_cb), job);
+
+	SoupMessageHeaders *headers = soup_message_get_request_headers (job->msg);
+	if (job->etag)
+		soup_message_headers_replace (headers, "If-None-Match", job->etag);
+	if (job->last_modified)
+		soup_message_headers_replace (headers, "If-Modified-Since", job->last_modified);
+
+	soup_session_send_and_read_async (job->fetcher->session,
+                                      job->msg,
+                                      G_PRIORITY_DEFAULT,
+                                      job->cancellable,
+                                      fetch_job_done_cb,
+                                      job);
+
+	return TRUE;
+}
+
+static void
+fetcher_dispatch (FaviconFetcher *fetcher)
+{
+	while (fetcher->active < fetcher->max_concurrent &&
+           !g_queue_is_empty (&fetcher->pending)) {
+		FetchJob *job = g_queue_pop_head (&fetcher->pending);
+
+		/* cancelled or malformed url */
+		if (fetcher->cancelled || !fetch_job_send (job)) {
+			fetch_job_finish (job, 0, NULL);
+			continue;
+		}
+
+		/* the deadline covers every retry of the request */
+		job->deadline = g_get_monotonic_time () + fetcher->timeout_ms * G_GINT64_CONSTANT (1000);
+		job->timeout_id = fetcher_add_timeout (fetcher, fetcher->timeout_ms, fetch_job_timeout_cb, job);
+		fetcher->running = g_list_prepend (fetcher->running, job);
+		fetcher->active++;
+	}
+
+	if (fetcher->active == 0 && g_main_loop_is_running (fetcher->loop))
+		g_main_loop_quit (fetcher->loop);
+}
+
+static void
+fetch_job_complete (FetchJob *job, guint status, GBytes *body)
+{
+	FaviconFetcher *fetcher = job->fetcher;
+
+	fetcher->running = g_list_remove (fetcher->running, job);
+	fetch_job_finish (job, status, body);
+
+	fetcher->active--;
+	fetcher_dispatch (fetcher);
+}
+
+static gboolean
+fetch_job_retry_cb (gpointer user_data)
+{
+	FetchJob *job = (FetchJob *)user_data;
+
+	job->retry_id = 0;
+
+	if (!fetch_job_send (job))
+		fetch_job_complete (job, 0, NULL);
+
+	return FALSE;
+}
+
+static gboolean
+fetch_job_timeout_cb (gpointer user_data)
+{
+	FetchJob *job = (FetchJob *)user_data;
+
+	job->timeout_id = 0;
+
+	/* nothing in flight to cancel while waiting for a retry */
+	if (job->retry_id > 0)
+		fetch_job_complete (job, 0, NULL);
+	else
+		g_cancellable_cancel (job->cancellable);
+
+	return FALSE;
+}
+
+static void
+fetch_job_done_cb (GObject      *source_object,
+                   GAsyncResult *result,
+                   gpointer      user_data)
+{
+	guint status = 0;
+	GBytes *body = NULL;
+	GError *error = NULL;
+	FetchJob *job = (FetchJob *)user_data;
+
+	body = soup_session_send_and_read_finish (SOUP_SESSION (source_object), result, &error);
+
+	if (error) {
+		/* 250 ms, 500 ms, ... as long as the deadline leaves room
+		 * for another attempt after the wait */
+		guint delay = FETCH_RETRY_DELAY << job->retry;
+		gboolean retry = !g_cancellable_is_cancelled (job->cancellable) &&
+                         job->retry < FETCH_MAX_RETRY &&
+                         g_get_monotonic_time () + delay * G_GINT64_CONSTANT (1000) < job->deadline;
+
+		g_error_free (error);
+
+		if (retry) {
+			job->retry++;
+			job->retry_id = fetcher_add_timeout (job->fetcher, delay, fetch_job_retry_cb, job);
+			return;
+		}
+	} else {
+		status = soup_message_get_status (job->msg);
+	}
+
+	fetch_job_complete (job, status, body);
+
+	if (body)
+		g_bytes_unref (body);
+}
+
+FaviconFetcher *
+favicon_fetcher_new (guint max_concurrent, guint timeout_ms)
+{
+	FaviconFetcher *fetcher;
+	GMainContext *context;
+
+	fetcher = g_new0 (FaviconFetcher, 1);
+	fetcher->max_concurrent = MAX (max_concurrent, 1);
+	fetcher->timeout_ms = timeout_ms;
+
+	/* SoupSession keeps idle connections alive and reuses them per host */
+	fetcher->session = soup_session_new_with_options ("max-conns", fetcher->max_concurrent,
+                                                      "max-conns-per-host", FETCH_MAX_CONNS_PER_HOST,
+                                                      "timeout", MAX (timeout_ms / 1000, 1),
+                                                      "user-agent", "gooroom-update-launchers-helper",
+                                                      NULL);
+
+	context = g_main_context_ref_thread_default ();
+	fetcher->loop = g_main_loop_new (context, FALSE);
+	g_main_context_unref (context);
+
+	g_queue_init (&fetcher->pending);
+
+	return fetcher;
+}
+
+void
+favicon_fetcher_free (FaviconFetcher *fetcher)
+{
+	if (!fetcher)
+		return;
+
+	g_queue_clear_full (&fetcher->pending, (GDestroyNotify) fetch_job_free);
+	g_list_free (fetcher->running);
+
+	g_object_unref (fetcher->session);
+	g_main_loop_unref (fetcher->loop);
+	g_free (fetcher);
+}
+
+void
+favicon_fetcher_add (FaviconFetcher     *fetcher,
+                     const gchar        *url,
+                     const gchar        *etag,
+                     const gchar        *last_modified,
+                     FaviconFetcherFunc  func,
+                     gpointer            user_data,
+                     GDestroyNotify      destroy)
+{
+	g_return_if_fail (fetcher != NULL);
+	g_return_if_fail (url != NULL);
+
+	FetchJob *job = g_new0 (FetchJob, 1);
+
+	job->fetcher       = fetcher;
+	job->url           = g_strdup (url);
+	job->etag          = g_strdup (etag);
+	job->last_modified = g_strdup (last_modified);
+	job->cancellable   = g_cancellable_new ();
+	job->func          = func;
+	job->user_data     = user_data;
+	job->destroy       = destroy;
+
+	g_queue_push_tail (&fetcher->pending, job);
+}
+
+static gboolean
+fetcher_cancelled_cb (GCancellable *cancellable, gpointer user_data)
+{
+	GList *l, *running;
+	FaviconFetcher *fetcher = (FaviconFetcher *)user_data;
+
+	/* runs in the fetcher's own context, so the lists are safe to use */
+	fetcher->cancelled = TRUE;
+
+	/* jobs waiting for a retry complete right here */
+	running = g_list_copy (fetcher->running);
+	for (l = running; l; l = l->next) {
+		FetchJob *job = (FetchJob *)l->data;
+
+		if (job->retry_id > 0)
+			fetch_job_complete (job, 0, NULL);
+		else
+			g_cancellable_cancel (job->cancellable);
+	}
+	g_list_free (running);
+
+	return FALSE;
+}
+
+void
+favicon_fetcher_run (FaviconFetcher *fetcher, GCancellable *cancellable)
+{
+	GSource *source = NULL;
+
+	g_return_if_fail (fetcher != NULL);
+
+	if (cancellable) {
+		source = g_cancellable_source_new (cancellable);
+		g_source_set_callback (source, (GSourceFunc) fetcher_cancelled_cb, fetcher, NULL);
+		g_source_attach (source, g_main_loop_get_context (fetcher->loop));
+	}
+
+	fetcher_dispatch (fetcher);
+
+	if (fetcher->active > 0)
+		g_main_loop_run (fetcher->loop);
+
+	if (source) {
+		g_source_destroy (source);
+		g_source_unref (source);
+	}
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __FAVICON_FETCHER_H__
+#define __FAVICON_FETCHER_H__
+
+#include <glib.h>
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+typedef struct _FaviconFetcher FaviconFetcher;
+
+typedef struct
+{
+	/* HTTP status code, or 0 on transport error and timeout */
+	guint        status;
+	/* the run was cancelled before the request completed */
+	gboolean     cancelled;
+	/* NULL unless the request succeeded with a 2xx status */
+	GBytes      *body;
+	const gchar *etag;
+	const gchar *last_modified;
+} FaviconFetchResult;
+
+typedef void (*FaviconFetcherFunc) (const gchar              *url,
+                                    const FaviconFetchResult *result,
+                                    gpointer                  user_data);
+
+FaviconFetcher *favicon_fetcher_new  (guint               max_concurrent,
+                                      guint               timeout_ms);
+void            favicon_fetcher_free (FaviconFetcher     *fetcher);
+
+/* etag and last_modified are optional validators of a cached copy;
+ * the server answers 304 when that copy is still current. */
+void            favicon_fetcher_add  (FaviconFetcher     *fetcher,
+                                      const gchar        *url,
+                                      const gchar        *etag,
+                                      const gchar        *last_modified,
+                                      FaviconFetcherFunc  func,
+                                      gpointer            user_data,
+                                      GDestroyNotify      destroy);
+
+/* Runs the thread-default main context until every queued request has
+ * completed, hit its deadline or been cancelled. */
+void            favicon_fetcher_run  (FaviconFetcher     *fetcher,
+                                      GCancellable       *cancellable);
+
+G_END_DECLS
+
+#endif /* __FAVICON_FETCHER_H__ */
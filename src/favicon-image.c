@@ -0,0 +1,480 @@
+/*
+ * Copyright (C) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include "favicon-image.h"
+
+#define MAX_IMAGE_BYTES		(1024 * 1024)
+#define MAX_IMAGE_PIXELS	4096
+#define SVG_SNIFF_LENGTH	1024
+#define UPDATE_ICON_CACHE	"gtk-update-icon-cache"
+
+/* sizes the panel draws launcher icons at, largest last */
+static const gint icon_sizes[] = { 16, 24, 32, 48, 64 };
+
+
+static gchar *
+get_icon_directory (gint size)
+{
+	gchar *dir, *size_dir;
+
+	size_dir = g_strdup_printf ("%dx%d", size, size);
+	dir = g_build_filename (g_get_user_data_dir (), "icons", "hicolor", size_dir, "apps", NULL);
+	g_free (size_dir);
+
+	return dir;
+}
+
+static gchar *
+get_icon_path (gint size, const gchar *icon_name)
+{
+	gchar *dir, *file, *path;
+
+	dir = get_icon_directory (size);
+	file = g_strdup_printf ("%s.png", icon_name);
+	path = g_build_filename (dir, file, NULL);
+	g_free (dir);
+	g_free (file);
+
+	return path;
+}
+
+static gboolean
+has_magic (const guchar *data, gsize len, const gchar *magic, gsize magic_len)
+{
+	return (len >= magic_len && memcmp (data, magic, magic_len) == 0);
+}
+
+static gboolean
+is_svg (const guchar *data, gsize len)
+{
+	const gchar *p = (const gchar *)data;
+	gsize n = MIN (len, SVG_SNIFF_LENGTH);
+
+	/* skip BOM and leading white space */
+	if (n >= 3 && memcmp (p, "\xef\xbb\xbf", 3) == 0) {
+		p += 3;
+		n -= 3;
+	}
+	while (n > 0 && g_ascii_isspace (*p)) {
+		p++;
+		n--;
+	}
+
+	if (n == 0 || *p != '<')
+		return FALSE;
+
+	return g_strstr_len (p, n, "<svg") != NULL;
+}
+
+static void
+loader_size_prepared_cb (GdkPixbufLoader *loader,
+                         gint             width,
+                         gint             height,
+                         gpointer         user_data)
+{
+	gint max_size = icon_sizes[G_N_ELEMENTS (icon_sizes) - 1];
+
+	if (width > MAX_IMAGE_PIXELS || height > MAX_IMAGE_PIXELS) {
+		/* a zero size makes the loader stop decoding */
+		gdk_pixbuf_loader_set_size (loader, 0, 0);
+		return;
+	}
+
+	/* decode straight at the largest size we are going to need */
+	if (width > max_size || height > max_size) {
+		gdouble scale = (gdouble)max_size / MAX (width, height);
+		gdk_pixbuf_loader_set_size (loader,
+                                    MAX ((gint)(width * scale), 1),
+                                    MAX ((gint)(height * scale), 1));
+	}
+}
+
+static GdkPixbuf *
+normalize_pixbuf (GdkPixbuf *pixbuf, gint size)
+{
+	gint width, height, dest_width, dest_height;
+	gdouble scale;
+	GdkPixbuf *dest;
+
+	width = gdk_pixbuf_get_width (pixbuf);
+	height = gdk_pixbuf_get_height (pixbuf);
+
+	scale = (gdouble)size / MAX (width, height);
+	dest_width = CLAMP ((gint)(width * scale + 0.5), 1, size);
+	dest_height = CLAMP ((gint)(height * scale + 0.5), 1, size);
+
+	/* keep the aspect ratio and center on a transparent square */
+	dest = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8, size, size);
+	gdk_pixbuf_fill (dest, 0x00000000);
+
+	gdk_pixbuf_scale (pixbuf, dest,
+                      (size - dest_width) / 2, (size - dest_height) / 2,
+                      dest_width, dest_height,
+                      (size - dest_width) / 2, (size - dest_height) / 2,
+                      (gdouble)dest_width / width, (gdouble)dest_height / height,
+                      GDK_INTERP_HYPER);
+
+	return dest;
+}
+
+FaviconImageFormat
+favicon_image_sniff (GBytes *data)
+{
+	gsize len = 0;
+	const guchar *p;
+
+	g_return_val_if_fail (data != NULL, FAVICON_IMAGE_UNKNOWN);
+
+	p = g_bytes_get_data (data, &len);
+
+	if (has_magic (p, len, "\x89PNG\r\n\x1a\n", 8))
+		return FAVICON_IMAGE_PNG;
+	if (has_magic (p, len, "\xff\xd8\xff", 3))
+		return FAVICON_IMAGE_JPEG;
+	if (has_magic (p, len, "\x00\x00\x01\x00", 4))
+		return FAVICON_IMAGE_ICO;
+	if (is_svg (p, len))
+		return FAVICON_IMAGE_SVG;
+
+	return FAVICON_IMAGE_UNKNOWN;
+}
+
+GdkPixbuf *
+favicon_image_decode (GBytes *data, GError **error)
+{
+	gsize len = 0;
+	const guchar *p;
+	const gchar *type = NULL;
+	GdkPixbuf *pixbuf = NULL;
+	GdkPixbufLoader *loader;
+
+	g_return_val_if_fail (data != NULL, NULL);
+
+	p = g_bytes_get_data (data, &len);
+	if (len == 0 || len > MAX_IMAGE_BYTES) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                     "Image size %" G_GSIZE_FORMAT " is out of range", len);
+		return NULL;
+	}
+
+	switch (favicon_image_sniff (data)) {
+	case FAVICON_IMAGE_PNG:
+		type = "png";
+		break;
+	case FAVICON_IMAGE_JPEG:
+		type = "jpeg";
+		break;
+	case FAVICON_IMAGE_SVG:
+		type = "svg";
+		break;
+	case FAVICON_IMAGE_ICO:
+		type = "ico";
+		break;
+	default:
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED, "Unknown image format");
+		return NULL;
+	}
+
+	/* pick the loader from the magic bytes instead of letting
+	 * gdk-pixbuf probe every module it knows */
+	loader = gdk_pixbuf_loader_new_with_type (type, error);
+	if (!loader)
+		return NULL;
+
+	g_signal_connect (loader, "size-prepared", G_CALLBACK (loader_size_prepared_cb), NULL);
+
+	if (gdk_pixbuf_loader_write (loader, p, len, error) &&
+        gdk_pixbuf_loader_close (loader, error)) {
+		pixbuf = gdk_pixbuf_loader_get_pixbuf (loader);
+		if (pixbuf)
+			g_object_ref (pixbuf);
+	} else {
+		gdk_pixbuf_loader_close (loader, NULL);
+	}
+
+	g_object_unref (loader);
+
+	if (!pixbuf && error && !*error)
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "Could not decode image");
+
+	return pixbuf;
+}
+
+gboolean
+favicon_image_install (GdkPixbuf *pixbuf, const gchar *icon_name, GError **error)
+{
+	guint i;
+
+	g_return_val_if_fail (pixbuf != NULL, FALSE);
+	g_return_val_if_fail (icon_name != NULL, FALSE);
+
+	for (i = 0; i < G_N_ELEMENTS (icon_sizes); i++) {
+		gsize len = 0;
+		gchar *buffer = NULL, *dir, *path;
+		gboolean ret = FALSE;
+		GdkPixbuf *icon;
+
+		dir = get_icon_directory (icon_sizes[i]);
+		g_mkdir_with_parents (dir, 0755);
+		g_free (dir);
+
+		icon = normalize_pixbuf (pixbuf, icon_sizes[i]);
+		path = get_icon_path (icon_sizes[i], icon_name);
+
+		if (gdk_pixbuf_save_to_buffer (icon, &buffer, &len, "png", error, NULL))
+			ret = g_file_set_contents (path, buffer, len, error);
+
+		g_free (buffer);
+		g_free (path);
+		g_object_unref (icon);
+
+		if (!ret)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+gboolean
+favicon_image_is_installed (const gchar *icon_name)
+{
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS (icon_sizes); i++) {
+		gboolean exists;
+		gchar *path = get_icon_path (icon_sizes[i], icon_name);
+
+		exists = g_file_test (path, G_FILE_TEST_IS_REGULAR);
+		g_free (path);
+
+		if (!exists)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+void
+favicon_image_prune (GHashTable *icon_names)
+{
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS (icon_sizes); i++) {
+		GDir *dir;
+		const gchar *name;
+		gchar *dir_name = get_icon_directory (icon_sizes[i]);
+
+		dir = g_dir_open (dir_name, 0, NULL);
+		if (!dir) {
+			g_free (dir_name);
+			continue;
+		}
+
+		while ((name = g_dir_read_name (dir)) != NULL) {
+			gchar *icon_name;
+
+			if (!g_str_has_prefix (name, FAVICON_ICON_PREFIX) || !g_str_has_suffix (name, ".png"))
+				continue;
+
+			icon_name = g_strndup (name, strlen (name) - strlen (".png"));
+			if (!g_hash_table_contains (icon_names, icon_name)) {
+				gchar *path = g_build_filename (dir_name, name, NULL);
+				g_unlink (path);
+				g_free (path);
+			}
+			g_free (icon_name);
+		}
+
+		g_dir_close (dir);
+		g_free (dir_name);
+	}
+}
+
+static gboolean
+is_atlas_current (const gchar *src, const gchar *dst)
+{
+	GStatBuf src_st, dst_st;
+
+	if (g_stat (src, &src_st) != 0 || g_stat (dst, &dst_st) != 0)
+		return FALSE;
+
+	/* a hard link, or a copy at least as new as the icon */
+	if (src_st.st_dev == dst_st.st_dev && src_st.st_ino == dst_st.st_ino)
+		return TRUE;
+
+	return (src_st.st_size == dst_st.st_size && dst_st.st_mtime >= src_st.st_mtime);
+}
+
+static gboolean
+add_to_atlas (const gchar *src, const gchar *dst)
+{
+	gboolean ret;
+	GFile *src_file, *dst_file;
+
+	g_unlink (dst);
+
+	/* hard links cost no space and keep the pages shared */
+	if (link (src, dst) == 0)
+		return TRUE;
+
+	src_file = g_file_new_for_path (src);
+	dst_file = g_file_new_for_path (dst);
+	ret = g_file_copy (src_file, dst_file, G_FILE_COPY_OVERWRITE, NULL, NULL, NULL, NULL);
+	g_object_unref (src_file);
+	g_object_unref (dst_file);
+
+	return ret;
+}
+
+static gboolean
+update_atlas_directory (const gchar *atlas_dir, gint size, GHashTable *icon_names)
+{
+	GDir *dir;
+	gpointer key;
+	GHashTableIter iter;
+	const gchar *name;
+	gchar *dir_name, *size_dir;
+	gboolean changed = FALSE;
+
+	size_dir = g_strdup_printf ("%dx%d", size, size);
+	dir_name = g_build_filename (atlas_dir, "hicolor", size_dir, "apps", NULL);
+	g_free (size_dir);
+
+	if (g_mkdir_with_parents (dir_name, 0700) != 0) {
+		g_free (dir_name);
+		return FALSE;
+	}
+
+	/* drop the icons that left the policy */
+	dir = g_dir_open (dir_name, 0, NULL);
+	if (dir) {
+		while ((name = g_dir_read_name (dir)) != NULL) {
+			gchar *icon_name;
+
+			if (!g_str_has_prefix (name, FAVICON_ICON_PREFIX) || !g_str_has_suffix (name, ".png"))
+				continue;
+
+			icon_name = g_strndup (name, strlen (name) - strlen (".png"));
+			if (!g_hash_table_contains (icon_names, icon_name)) {
+				gchar *path = g_build_filename (dir_name, name, NULL);
+				if (g_unlink (path) == 0)
+					changed = TRUE;
+				g_free (path);
+			}
+			g_free (icon_name);
+		}
+		g_dir_close (dir);
+	}
+
+	/* and bring in the new and the replaced ones */
+	g_hash_table_iter_init (&iter, icon_names);
+	while (g_hash_table_iter_next (&iter, &key, NULL)) {
+		gchar *src, *dst, *file;
+
+		src = get_icon_path (size, key);
+		file = g_strdup_printf ("%s.png", (const gchar *)key);
+		dst = g_build_filename (dir_name, file, NULL);
+
+		if (!g_file_test (src, G_FILE_TEST_EXISTS)) {
+			if (g_unlink (dst) == 0)
+				changed = TRUE;
+		} else if (!is_atlas_current (src, dst)) {
+			add_to_atlas (src, dst);
+			changed = TRUE;
+		}
+
+		g_free (src);
+		g_free (file);
+		g_free (dst);
+	}
+
+	g_free (dir_name);
+
+	return changed;
+}
+
+gboolean
+favicon_image_update_atlas (const gchar  *atlas_dir,
+                            GHashTable   *icon_names,
+                            GError      **error)
+{
+	guint i;
+	gint status;
+	gboolean ret;
+	gboolean changed = FALSE;
+	gchar *theme_dir, *cache_path, *program;
+
+	g_return_val_if_fail (atlas_dir != NULL, FALSE);
+	g_return_val_if_fail (icon_names != NULL, FALSE);
+
+	for (i = 0; i < G_N_ELEMENTS (icon_sizes); i++) {
+		if (update_atlas_directory (atlas_dir, icon_sizes[i], icon_names))
+			changed = TRUE;
+	}
+
+	theme_dir = g_build_filename (atlas_dir, "hicolor", NULL);
+	cache_path = g_build_filename (theme_dir, "icon-theme.cache", NULL);
+
+	if (!changed && g_file_test (cache_path, G_FILE_TEST_EXISTS)) {
+		g_free (theme_dir);
+		g_free (cache_path);
+		return TRUE;
+	}
+
+	program = g_find_program_in_path (UPDATE_ICON_CACHE);
+	if (!program) {
+		/* a stale cache would hide the icons it does not list */
+		g_unlink (cache_path);
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                     "%s is not installed", UPDATE_ICON_CACHE);
+		g_free (theme_dir);
+		g_free (cache_path);
+		return FALSE;
+	}
+
+	{
+		gchar *argv[] = { program, "--force", "--ignore-theme-index",
+                          "--include-image-data", "--quiet", theme_dir, NULL };
+
+		ret = g_spawn_sync (NULL, argv, NULL,
+                            G_SPAWN_STDOUT_TO_DEV_NULL | G_SPAWN_STDERR_TO_DEV_NULL,
+                            NULL, NULL, NULL, NULL, &status, error);
+	}
+
+	if (ret && !(WIFEXITED (status) && WEXITSTATUS (status) == 0)) {
+		g_unlink (cache_path);
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                     "%s failed for %s", UPDATE_ICON_CACHE, theme_dir);
+		ret = FALSE;
+	}
+
+	g_free (program);
+	g_free (theme_dir);
+	g_free (cache_path);
+
+	return ret;
+}
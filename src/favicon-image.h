@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __FAVICON_IMAGE_H__
+#define __FAVICON_IMAGE_H__
+
+#include <glib.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+G_BEGIN_DECLS
+
+#define FAVICON_ICON_PREFIX	"gooroom-favicon-"
+
+typedef enum
+{
+	FAVICON_IMAGE_UNKNOWN = 0,
+	FAVICON_IMAGE_PNG,
+	FAVICON_IMAGE_JPEG,
+	FAVICON_IMAGE_SVG,
+	FAVICON_IMAGE_ICO
+} FaviconImageFormat;
+
+FaviconImageFormat  favicon_image_sniff        (GBytes      *data);
+GdkPixbuf          *favicon_image_decode       (GBytes      *data,
+                                                GError     **error);
+
+/* Normalized copies are installed into the user's hicolor icon theme so
+ * that the dock can look them up by icon name at the size it needs. */
+gboolean            favicon_image_install      (GdkPixbuf   *pixbuf,
+                                                const gchar *icon_name,
+                                                GError     **error);
+gboolean            favicon_image_is_installed (const gchar *icon_name);
+void                favicon_image_prune        (GHashTable  *icon_names);
+
+/* Mirrors the installed icon_names into a hicolor theme below atlas_dir
+ * whose icon-theme.cache carries the pixel data, so that GTK maps one
+ * file and draws from it instead of decoding every PNG. Only what changed
+ * is relinked, and the cache is rebuilt only then. */
+gboolean            favicon_image_update_atlas (const gchar *atlas_dir,
+                                                GHashTable  *icon_names,
+                                                GError     **error);
+
+G_END_DECLS
+
+#endif /* __FAVICON_IMAGE_H__ */
@@ -0,0 +1,207 @@
+/*
+ * Copyright (C) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <string.h>
+
+#include <glib.h>
+#include <gio/gio.h>
+#include <gio/gdesktopappinfo.h>
+
+#include "launcher-index.h"
+
+
+struct _LauncherIndex
+{
+	GHashTable *names;
+	GHashTable *execs;
+};
+
+
+static gchar *
+normalize_name (const gchar *name)
+{
+	gchar *normalized, *ret;
+
+	if (!name)
+		return NULL;
+
+	normalized = g_utf8_normalize (name, -1, G_NORMALIZE_ALL);
+	if (!normalized)
+		return NULL;
+
+	ret = g_utf8_casefold (g_strstrip (normalized), -1);
+	g_free (normalized);
+
+	if (*ret == '\0')
+		g_clear_pointer (&ret, g_free);
+
+	return ret;
+}
+
+static gchar *
+normalize_exec (const gchar *exec)
+{
+	guint i;
+	gchar **argv;
+	GString *ret;
+
+	if (!exec)
+		return NULL;
+
+	ret = g_string_new (NULL);
+
+	/* field codes like %U do not tell two commands apart */
+	argv = g_strsplit_set (exec, " \t", -1);
+	for (i = 0; argv[i] != NULL; i++) {
+		if (*argv[i] == '\0')
+			continue;
+		if (argv[i][0] == '%' && strlen (argv[i]) == 2 && argv[i][1] != '%')
+			continue;
+
+		if (ret->len > 0)
+			g_string_append_c (ret, ' ');
+		g_string_append (ret, argv[i]);
+	}
+	g_strfreev (argv);
+
+	if (ret->len == 0) {
+		g_string_free (ret, TRUE);
+		return NULL;
+	}
+
+	return g_string_free (ret, FALSE);
+}
+
+static void
+launcher_get_name_exec (const gchar *launcher, gchar **name, gchar **exec)
+{
+	const gchar *path;
+	GKeyFile *keyfile;
+
+	*name = *exec = NULL;
+
+	/* DockbarX stores launchers as "id;/path/to/file.desktop" */
+	path = strchr (launcher, ';');
+	if (!path) {
+		GDesktopAppInfo *dt_info = g_desktop_app_info_new (launcher);
+		if (dt_info) {
+			*name = g_desktop_app_info_get_string (dt_info, G_KEY_FILE_DESKTOP_KEY_NAME);
+			*exec = g_desktop_app_info_get_string (dt_info, G_KEY_FILE_DESKTOP_KEY_EXEC);
+			g_object_unref (dt_info);
+		}
+		return;
+	}
+
+	keyfile = g_key_file_new ();
+	if (g_key_file_load_from_file (keyfile, path + 1, G_KEY_FILE_NONE, NULL)) {
+		*name = g_key_file_get_string (keyfile, G_KEY_FILE_DESKTOP_GROUP, G_KEY_FILE_DESKTOP_KEY_NAME, NULL);
+		*exec = g_key_file_get_string (keyfile, G_KEY_FILE_DESKTOP_GROUP, G_KEY_FILE_DESKTOP_KEY_EXEC, NULL);
+	}
+	g_key_file_free (keyfile);
+}
+
+LauncherIndex *
+launcher_index_new (void)
+{
+	LauncherIndex *index = g_new0 (LauncherIndex, 1);
+
+	index->names = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+	index->execs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+	return index;
+}
+
+void
+launcher_index_free (LauncherIndex *index)
+{
+	if (!index)
+		return;
+
+	g_hash_table_destroy (index->names);
+	g_hash_table_destroy (index->execs);
+	g_free (index);
+}
+
+gboolean
+launcher_index_add (LauncherIndex *index, const gchar *launcher)
+{
+	gboolean ret = FALSE;
+	gchar *name = NULL, *exec = NULL;
+	gchar *n_name = NULL, *n_exec = NULL;
+
+	g_return_val_if_fail (index != NULL, FALSE);
+	g_return_val_if_fail (launcher != NULL, FALSE);
+
+	/* every launcher is read from disk exactly once */
+	launcher_get_name_exec (launcher, &name, &exec);
+
+	n_name = normalize_name (name);
+	n_exec = normalize_exec (exec);
+
+	if ((n_name && g_hash_table_contains (index->names, n_name)) ||
+        (n_exec && g_hash_table_contains (index->execs, n_exec)))
+		goto out;
+
+	if (n_name)
+		g_hash_table_insert (index->names, g_steal_pointer (&n_name), g_strdup (launcher));
+	if (n_exec)
+		g_hash_table_insert (index->execs, g_steal_pointer (&n_exec), g_strdup (launcher));
+
+	ret = TRUE;
+
+out:
+	g_free (name);
+	g_free (exec);
+	g_free (n_name);
+	g_free (n_exec);
+
+	return ret;
+}
+
+GSList *
+launcher_index_merge (GSList *old_launchers, GSList *new_launchers)
+{
+	GSList *l;
+	GSList *ret_launchers = NULL;
+	LauncherIndex *index = NULL;
+
+	if (!old_launchers && !new_launchers)
+		return NULL;
+
+	if (old_launchers && !new_launchers)
+		return g_slist_copy_deep (old_launchers, (GCopyFunc)g_strdup, NULL);
+
+	index = launcher_index_new ();
+
+	for (l = old_launchers; l; l = l->next) {
+		gchar *old_launcher = (gchar *)l->data;
+		launcher_index_add (index, old_launcher);
+		ret_launchers = g_slist_prepend (ret_launchers, g_strdup (old_launcher));
+	}
+
+	/* skip launchers whose Name or Exec is already pinned */
+	for (l = new_launchers; l; l = l->next) {
+		gchar *new_launcher = (gchar *)l->data;
+		if (launcher_index_add (index, new_launcher))
+			ret_launchers = g_slist_prepend (ret_launchers, g_strdup (new_launcher));
+	}
+
+	launcher_index_free (index);
+
+	return g_slist_reverse (ret_launchers);
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __LAUNCHER_INDEX_H__
+#define __LAUNCHER_INDEX_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Maps the normalized Name and Exec of DockbarX launchers
+ * ("id;/path/to/file.desktop" or a desktop id) to the launcher. */
+typedef struct _LauncherIndex LauncherIndex;
+
+LauncherIndex *launcher_index_new   (void);
+void           launcher_index_free  (LauncherIndex *index);
+
+/* Returns FALSE, and leaves the index untouched, when a launcher with
+ * the same Name or Exec is already indexed. */
+gboolean       launcher_index_add   (LauncherIndex *index,
+                                     const gchar   *launcher);
+
+/* The old launchers followed by the new ones that do not repeat the Name
+ * or Exec of a launcher before them; old launchers always stay. */
+GSList        *launcher_index_merge (GSList        *old_launchers,
+                                     GSList        *new_launchers);
+
+G_END_DECLS
+
+#endif /* __LAUNCHER_INDEX_H__ */
@@ -0,0 +1,242 @@
+/*
+ * Copyright (C) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "launcher-manifest.h"
+
+#define POLICY_GROUP		"Policy"
+
+#define KEY_DIGEST			"Digest"
+#define KEY_REVALIDATE		"Revalidate"
+#define KEY_LAUNCHERS		"Launchers"
+#define KEY_FILE			"File"
+
+#define ENTRY_GROUP_PREFIX	"Launcher "
+
+
+struct _LauncherManifest
+{
+	gchar      *path;
+	GKeyFile   *keyfile;
+
+	/* groups set since the manifest was loaded */
+	GHashTable *seen;
+};
+
+
+static gchar *
+entry_group (const gchar *id)
+{
+	return g_strconcat (ENTRY_GROUP_PREFIX, id, NULL);
+}
+
+LauncherManifest *
+launcher_manifest_load (const gchar *path)
+{
+	g_return_val_if_fail (path != NULL, NULL);
+
+	LauncherManifest *manifest = g_new0 (LauncherManifest, 1);
+
+	manifest->path    = g_strdup (path);
+	manifest->keyfile = g_key_file_new ();
+	manifest->seen    = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	g_key_file_load_from_file (manifest->keyfile, path, G_KEY_FILE_NONE, NULL);
+
+	return manifest;
+}
+
+void
+launcher_manifest_free (LauncherManifest *manifest)
+{
+	if (!manifest)
+		return;
+
+	g_key_file_free (manifest->keyfile);
+	g_hash_table_destroy (manifest->seen);
+	g_free (manifest->path);
+	g_free (manifest);
+}
+
+gboolean
+launcher_manifest_save (LauncherManifest *manifest)
+{
+	gboolean ret;
+	gchar *dir;
+
+	g_return_val_if_fail (manifest != NULL, FALSE);
+
+	dir = g_path_get_dirname (manifest->path);
+	g_mkdir_with_parents (dir, 0700);
+	g_free (dir);
+
+	ret = g_key_file_save_to_file (manifest->keyfile, manifest->path, NULL);
+
+	return ret;
+}
+
+gboolean
+launcher_manifest_is_empty (LauncherManifest *manifest)
+{
+	return !g_key_file_has_group (manifest->keyfile, POLICY_GROUP);
+}
+
+gboolean
+launcher_manifest_is_current (LauncherManifest *manifest,
+                              const gchar      *policy_digest,
+                              gint64            now)
+{
+	guint i;
+	gchar **groups;
+	gchar *digest;
+	gint64 revalidate;
+	gboolean ret = TRUE;
+
+	digest = g_key_file_get_string (manifest->keyfile, POLICY_GROUP, KEY_DIGEST, NULL);
+	revalidate = g_key_file_get_int64 (manifest->keyfile, POLICY_GROUP, KEY_REVALIDATE, NULL);
+
+	ret = (g_strcmp0 (digest, policy_digest) == 0 && now < revalidate);
+	g_free (digest);
+
+	if (!ret)
+		return FALSE;
+
+	/* somebody may have removed what we wrote */
+	groups = g_key_file_get_groups (manifest->keyfile, NULL);
+	for (i = 0; ret && groups[i] != NULL; i++) {
+		if (!g_str_has_prefix (groups[i], ENTRY_GROUP_PREFIX))
+			continue;
+
+		gchar *file = g_key_file_get_string (manifest->keyfile, groups[i], KEY_FILE, NULL);
+		ret = (file && g_file_test (file, G_FILE_TEST_IS_REGULAR));
+		g_free (file);
+	}
+	g_strfreev (groups);
+
+	return ret;
+}
+
+void
+launcher_manifest_set_policy (LauncherManifest *manifest,
+                              const gchar      *policy_digest,
+                              gint64            revalidate,
+                              GSList           *launchers)
+{
+	GSList *l = NULL;
+	GPtrArray *array;
+
+	array = g_ptr_array_new ();
+	for (l = launchers; l; l = l->next)
+		g_ptr_array_add (array, l->data);
+
+	g_key_file_set_string (manifest->keyfile, POLICY_GROUP, KEY_DIGEST, policy_digest);
+	g_key_file_set_int64 (manifest->keyfile, POLICY_GROUP, KEY_REVALIDATE, revalidate);
+	g_key_file_set_string_list (manifest->keyfile, POLICY_GROUP, KEY_LAUNCHERS,
+                                (const gchar * const *)array->pdata, array->len);
+
+	g_ptr_array_free (array, TRUE);
+}
+
+GSList *
+launcher_manifest_get_launchers (LauncherManifest *manifest)
+{
+	guint i;
+	gchar **launchers;
+	GSList *ret = NULL;
+
+	launchers = g_key_file_get_string_list (manifest->keyfile, POLICY_GROUP, KEY_LAUNCHERS, NULL, NULL);
+	if (!launchers)
+		return NULL;
+
+	for (i = 0; launchers[i] != NULL; i++)
+		ret = g_slist_prepend (ret, g_strdup (launchers[i]));
+
+	g_strfreev (launchers);
+
+	return g_slist_reverse (ret);
+}
+
+gboolean
+launcher_manifest_entry_matches (LauncherManifest *manifest,
+                                 const gchar      *id,
+                                 const gchar      *digest,
+                                 const gchar      *file)
+{
+	gchar *group, *old_digest, *old_file;
+	gboolean ret;
+
+	group = entry_group (id);
+	old_digest = g_key_file_get_string (manifest->keyfile, group, KEY_DIGEST, NULL);
+	old_file = g_key_file_get_string (manifest->keyfile, group, KEY_FILE, NULL);
+
+	ret = (g_strcmp0 (old_digest, digest) == 0 &&
+           g_strcmp0 (old_file, file) == 0 &&
+           g_file_test (file, G_FILE_TEST_IS_REGULAR));
+
+	g_free (group);
+	g_free (old_digest);
+	g_free (old_file);
+
+	return ret;
+}
+
+void
+launcher_manifest_set_entry (LauncherManifest *manifest,
+                             const gchar      *id,
+                             const gchar      *digest,
+                             const gchar      *file)
+{
+	gchar *group, *old_file;
+
+	group = entry_group (id);
+
+	/* the launcher moved to another directory */
+	old_file = g_key_file_get_string (manifest->keyfile, group, KEY_FILE, NULL);
+	if (old_file && g_strcmp0 (old_file, file) != 0)
+		g_unlink (old_file);
+	g_free (old_file);
+
+	g_key_file_set_string (manifest->keyfile, group, KEY_DIGEST, digest);
+	g_key_file_set_string (manifest->keyfile, group, KEY_FILE, file);
+
+	g_hash_table_add (manifest->seen, group);
+}
+
+void
+launcher_manifest_prune (LauncherManifest *manifest)
+{
+	guint i;
+	gchar **groups;
+
+	groups = g_key_file_get_groups (manifest->keyfile, NULL);
+	for (i = 0; groups[i] != NULL; i++) {
+		if (!g_str_has_prefix (groups[i], ENTRY_GROUP_PREFIX) ||
+            g_hash_table_contains (manifest->seen, groups[i]))
+			continue;
+
+		gchar *file = g_key_file_get_string (manifest->keyfile, groups[i], KEY_FILE, NULL);
+		if (file)
+			g_unlink (file);
+		g_free (file);
+
+		g_key_file_remove_group (manifest->keyfile, groups[i], NULL);
+	}
+	g_strfreev (groups);
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __LAUNCHER_MANIFEST_H__
+#define __LAUNCHER_MANIFEST_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Remembers what the last sync produced from the policy: a digest of the
+ * whole policy file and, per launcher, the digest and path of the desktop
+ * file written for it. */
+typedef struct _LauncherManifest LauncherManifest;
+
+LauncherManifest *launcher_manifest_load          (const gchar       *path);
+void              launcher_manifest_free          (LauncherManifest  *manifest);
+gboolean          launcher_manifest_save          (LauncherManifest  *manifest);
+gboolean          launcher_manifest_is_empty      (LauncherManifest  *manifest);
+
+gboolean          launcher_manifest_is_current    (LauncherManifest  *manifest,
+                                                   const gchar       *policy_digest,
+                                                   gint64             now);
+void              launcher_manifest_set_policy    (LauncherManifest  *manifest,
+                                                   const gchar       *policy_digest,
+                                                   gint64             revalidate,
+                                                   GSList            *launchers);
+GSList           *launcher_manifest_get_launchers (LauncherManifest  *manifest);
+
+gboolean          launcher_manifest_entry_matches (LauncherManifest  *manifest,
+                                                   const gchar       *id,
+                                                   const gchar       *digest,
+                                                   const gchar       *file);
+void              launcher_manifest_set_entry     (LauncherManifest  *manifest,
+                                                   const gchar       *id,
+                                                   const gchar       *digest,
+                                                   const gchar       *file);
+
+/* Deletes the files of entries that were not set since the manifest was
+ * loaded and forgets about them. */
+void              launcher_manifest_prune         (LauncherManifest  *manifest);
+
+G_END_DECLS
+
+#endif /* __LAUNCHER_MANIFEST_H__ */
@@ -0,0 +1,361 @@
+/*
+ * Copyright (C) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <glib/gstdio.h>
+#include <gtk/gtk.h>
+#include <gio/gdesktopappinfo.h>
+
+#include "launcher-table.h"
+#include "launcher-strip.h"
+
+#define ICON_SIZE	GTK_ICON_SIZE_LARGE_TOOLBAR
+
+
+struct _LauncherStripPrivate
+{
+	GSettings    *settings;
+	gulong        changed_id;
+
+	GFileMonitor *table_monitor;
+	/* of the launcher table the buttons were built from, 0 for none */
+	guint64       generation;
+	/* stops tables still being built once the strip is gone */
+	GCancellable *cancellable;
+};
+
+G_DEFINE_TYPE_WITH_PRIVATE (LauncherStrip, launcher_strip, GTK_TYPE_BOX)
+
+
+/* "id;/path/to/file.desktop", or a bare desktop id */
+static GDesktopAppInfo *
+get_launcher_app_info (const gchar *launcher)
+{
+	const gchar *path;
+
+	path = strchr (launcher, ';');
+	path = path ? path + 1 : launcher;
+
+	if (g_path_is_absolute (path))
+		return g_desktop_app_info_new_from_filename (path);
+
+	return g_desktop_app_info_new (path);
+}
+
+static void
+launcher_clicked_cb (GtkButton *button, gpointer data)
+{
+	GError *error = NULL;
+	GDesktopAppInfo *app_info;
+	GdkAppLaunchContext *context;
+
+	/* only read for the launcher that is actually used */
+	app_info = get_launcher_app_info ((const gchar *)data);
+	if (!app_info) {
+		g_warning ("Could not launch %s: the desktop file is gone", (const gchar *)data);
+		return;
+	}
+
+	context = gdk_display_get_app_launch_context (gtk_widget_get_display (GTK_WIDGET (button)));
+	gdk_app_launch_context_set_timestamp (context, gtk_get_current_event_time ());
+
+	if (!g_app_info_launch (G_APP_INFO (app_info), NULL, G_APP_LAUNCH_CONTEXT (context), &error)) {
+		g_warning ("Could not launch %s: %s", g_app_info_get_name (G_APP_INFO (app_info)), error->message);
+		g_error_free (error);
+	}
+
+	g_object_unref (context);
+	g_object_unref (app_info);
+}
+
+static GtkWidget *
+launcher_button_new (const gchar *launcher, const gchar *name, GIcon *icon)
+{
+	GtkWidget *button, *image;
+
+	if (icon)
+		image = gtk_image_new_from_gicon (icon, ICON_SIZE);
+	else
+		image = gtk_image_new_from_icon_name ("application-x-executable", ICON_SIZE);
+
+	button = gtk_button_new ();
+	gtk_button_set_relief (GTK_BUTTON (button), GTK_RELIEF_NONE);
+	gtk_widget_set_tooltip_text (button, name);
+	gtk_container_add (GTK_CONTAINER (button), image);
+
+	g_signal_connect_data (button, "clicked", G_CALLBACK (launcher_clicked_cb),
+                           g_strdup (launcher), (GClosureNotify) g_free, 0);
+
+	return button;
+}
+
+/* Builds the buttons from the launcher table, which saves reading every
+ * desktop file. */
+static void
+add_table_launchers (LauncherStrip *strip, LauncherTable *table)
+{
+	guint i;
+
+	for (i = 0; i < launcher_table_get_n_entries (table); i++) {
+		GIcon *icon = NULL;
+		LauncherTableEntry entry;
+
+		launcher_table_get_entry (table, i, &entry);
+
+		/* a launcher whose desktop file is gone is simply left out */
+		if (*entry.hash == '\0')
+			continue;
+
+		if (*entry.icon != '\0')
+			icon = g_icon_new_for_string (entry.icon, NULL);
+
+		gtk_box_pack_start (GTK_BOX (strip), launcher_button_new (entry.id, entry.name, icon), FALSE, FALSE, 0);
+
+		if (icon)
+			g_object_unref (icon);
+	}
+}
+
+static void
+add_launchers (LauncherStrip *strip, gchar **launchers)
+{
+	guint i;
+
+	for (i = 0; launchers[i] != NULL; i++) {
+		GDesktopAppInfo *app_info;
+
+		/* a launcher whose desktop file is gone is simply left out */
+		app_info = get_launcher_app_info (launchers[i]);
+		if (!app_info)
+			continue;
+
+		gtk_box_pack_start (GTK_BOX (strip),
+                            launcher_button_new (launchers[i],
+                                                 g_app_info_get_name (G_APP_INFO (app_info)),
+                                                 g_app_info_get_icon (G_APP_INFO (app_info))),
+                            FALSE, FALSE, 0);
+		g_object_unref (app_info);
+	}
+}
+
+static void
+build_table_thread (GTask        *task,
+                    gpointer      source_object,
+                    gpointer      task_data,
+                    GCancellable *cancellable)
+{
+	gchar *path;
+	guint i;
+	gchar **launchers = task_data;
+	GSList *list = NULL;
+	GError *error = NULL;
+
+	/* a table nobody reads would be kept up by every sync */
+	if (g_cancellable_is_cancelled (cancellable)) {
+		g_task_return_boolean (task, FALSE);
+		return;
+	}
+
+	for (i = 0; launchers[i] != NULL; i++)
+		list = g_slist_prepend (list, launchers[i]);
+	list = g_slist_reverse (list);
+
+	path = launcher_table_get_path ();
+	if (!launcher_table_update (path, list, &error)) {
+		g_warning ("Could not write the launcher table: %s", error->message);
+		g_error_free (error);
+	} else if (g_cancellable_is_cancelled (cancellable)) {
+		/* the strip went away while the table was being built */
+		g_unlink (path);
+	}
+	g_free (path);
+
+	g_slist_free (list);
+	g_task_return_boolean (task, TRUE);
+}
+
+/* Reading and hashing every desktop file is left to a thread; the table
+ * monitor reloads the strip from the table once it is written. */
+static void
+request_table (LauncherStrip *strip, gchar **launchers)
+{
+	GTask *task;
+
+	task = g_task_new (NULL, strip->priv->cancellable, NULL, NULL);
+	g_task_set_task_data (task, g_strdupv (launchers), (GDestroyNotify) g_strfreev);
+	g_task_run_in_thread (task, build_table_thread);
+	g_object_unref (task);
+}
+
+static void
+launcher_strip_reload (LauncherStrip *strip)
+{
+	gchar *path;
+	gchar **launchers;
+	LauncherTable *table;
+	LauncherStripPrivate *priv = strip->priv;
+
+	gtk_container_foreach (GTK_CONTAINER (strip), (GtkCallback) gtk_widget_destroy, NULL);
+	priv->generation = 0;
+
+	if (!priv->settings)
+		return;
+
+	launchers = g_settings_get_strv (priv->settings, "launchers");
+
+	path = launcher_table_get_path ();
+	table = launcher_table_load (path);
+	g_free (path);
+
+	/* the table is missing until the strip first asks for it, and
+	 * launchers pinned in DockbarX itself are not in it yet */
+	if (table && launcher_table_matches (table, (const gchar * const *)launchers)) {
+		add_table_launchers (strip, table);
+		priv->generation = launcher_table_get_generation (table);
+	} else {
+		add_launchers (strip, launchers);
+		request_table (strip, launchers);
+	}
+
+	if (table)
+		launcher_table_free (table);
+	g_strfreev (launchers);
+
+	gtk_widget_show_all (GTK_WIDGET (strip));
+}
+
+static void
+table_changed_cb (GFileMonitor      *monitor,
+                  GFile             *file,
+                  GFile             *other_file,
+                  GFileMonitorEvent  event_type,
+                  gpointer           data)
+{
+	gchar *path;
+	LauncherTable *table;
+	LauncherStrip *strip = LAUNCHER_STRIP (data);
+
+	if (event_type != G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT &&
+        event_type != G_FILE_MONITOR_EVENT_CREATED &&
+        event_type != G_FILE_MONITOR_EVENT_MOVED_IN &&
+        event_type != G_FILE_MONITOR_EVENT_RENAMED)
+		return;
+
+	/* the generation tells whether anything in it changed */
+	path = launcher_table_get_path ();
+	table = launcher_table_load (path);
+	g_free (path);
+
+	if (table) {
+		if (launcher_table_get_generation (table) != strip->priv->generation)
+			launcher_strip_reload (strip);
+		launcher_table_free (table);
+	}
+}
+
+static void
+launchers_changed_cb (GSettings *settings, const gchar *key, gpointer data)
+{
+	launcher_strip_reload (LAUNCHER_STRIP (data));
+}
+
+static void
+launcher_strip_finalize (GObject *object)
+{
+	gchar *path;
+	LauncherStrip *strip = LAUNCHER_STRIP (object);
+	LauncherStripPrivate *priv = strip->priv;
+
+	g_cancellable_cancel (priv->cancellable);
+	g_object_unref (priv->cancellable);
+
+	if (priv->settings) {
+		g_signal_handler_disconnect (priv->settings, priv->changed_id);
+		g_object_unref (priv->settings);
+
+		/* with nobody reading it, syncs stop updating the table */
+		path = launcher_table_get_path ();
+		g_unlink (path);
+		g_free (path);
+	}
+
+	if (priv->table_monitor) {
+		g_signal_handlers_disconnect_by_data (priv->table_monitor, strip);
+		g_object_unref (priv->table_monitor);
+	}
+
+	G_OBJECT_CLASS (launcher_strip_parent_class)->finalize (object);
+}
+
+static void
+launcher_strip_init (LauncherStrip *strip)
+{
+	strip->priv = launcher_strip_get_instance_private (strip);
+
+	strip->priv->settings      = NULL;
+	strip->priv->changed_id    = 0;
+	strip->priv->table_monitor = NULL;
+	strip->priv->generation    = 0;
+	strip->priv->cancellable   = g_cancellable_new ();
+}
+
+static void
+launcher_strip_class_init (LauncherStripClass *class)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (class);
+
+	object_class->finalize = launcher_strip_finalize;
+}
+
+GtkWidget *
+launcher_strip_new (GSettings *settings, GtkOrientation orientation)
+{
+	GFile *file;
+	gchar *path;
+	LauncherStrip *strip;
+
+	strip = g_object_new (LAUNCHER_TYPE_STRIP,
+                          "orientation", orientation,
+                          "spacing", 0,
+                          NULL);
+
+	if (settings) {
+		strip->priv->settings = g_object_ref (settings);
+		strip->priv->changed_id = g_signal_connect (settings, "changed::launchers",
+                                                    G_CALLBACK (launchers_changed_cb), strip);
+
+		/* the table may change on its own, favicons arrive late */
+		path = launcher_table_get_path ();
+		file = g_file_new_for_path (path);
+		strip->priv->table_monitor = g_file_monitor_file (file, G_FILE_MONITOR_WATCH_MOVES, NULL, NULL);
+		if (strip->priv->table_monitor)
+			g_signal_connect (strip->priv->table_monitor, "changed",
+                              G_CALLBACK (table_changed_cb), strip);
+		g_object_unref (file);
+		g_free (path);
+	}
+
+	launcher_strip_reload (strip);
+
+	return GTK_WIDGET (strip);
+}
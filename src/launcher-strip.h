@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __LAUNCHER_STRIP_H__
+#define __LAUNCHER_STRIP_H__
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+#define LAUNCHER_TYPE_STRIP           (launcher_strip_get_type ())
+#define LAUNCHER_STRIP(obj)           (G_TYPE_CHECK_INSTANCE_CAST ((obj), LAUNCHER_TYPE_STRIP, LauncherStrip))
+#define LAUNCHER_STRIP_CLASS(obj)     (G_TYPE_CHECK_CLASS_CAST    ((obj), LAUNCHER_TYPE_STRIP, LauncherStripClass))
+#define LAUNCHER_IS_STRIP(obj)        (G_TYPE_CHECK_INSTANCE_TYPE ((obj), LAUNCHER_TYPE_STRIP))
+#define LAUNCHER_IS_STRIP_CLASS(obj)  (G_TYPE_CHECK_CLASS_TYPE    ((obj), LAUNCHER_TYPE_STRIP))
+#define LAUNCHER_STRIP_GET_CLASS(obj) (G_TYPE_INSTANCE_GET_CLASS  ((obj), LAUNCHER_TYPE_STRIP, LauncherStripClass))
+
+typedef struct _LauncherStrip        LauncherStrip;
+typedef struct _LauncherStripClass   LauncherStripClass;
+typedef struct _LauncherStripPrivate LauncherStripPrivate;
+
+/* A row of plain launcher buttons for the "launchers" key of
+ * org.dockbarx, shown when DockbarX itself cannot be kept running. */
+struct _LauncherStrip {
+	GtkBox                parent;
+	LauncherStripPrivate *priv;
+};
+
+struct _LauncherStripClass {
+	GtkBoxClass parent_class;
+};
+
+GType      launcher_strip_get_type (void);
+
+/* settings may be NULL when DockbarX is not installed */
+GtkWidget *launcher_strip_new      (GSettings      *settings,
+                                    GtkOrientation  orientation);
+
+G_END_DECLS
+
+#endif /* __LAUNCHER_STRIP_H__ */
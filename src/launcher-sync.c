@@ -0,0 +1,1623 @@
+/*
+ * Copyright (C) 2018-2021 Gooroom <gooroom@gooroom.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/file.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#include <gio/gdesktopappinfo.h>
+
+#include <json-c/json.h>
+#include <libsoup/soup.h>
+
+#include "favicon-cache.h"
+#include "favicon-fetcher.h"
+#include "favicon-image.h"
+#include "launcher-index.h"
+#include "launcher-manifest.h"
+#include "launcher-sync.h"
+#include "launcher-table.h"
+#include "program-cache.h"
+
+#define GRM_USER	".grm-user"
+#define CUSTOM_DIR	"applications/custom"
+#define STAGING_LOCK	"." PACKAGE_NAME ".lock"
+
+#define FAVICON_MAX_CONCURRENT	8
+#define FAVICON_TIMEOUT			5000 /* ms */
+#define FAVICON_TTL				(60 * 60 * 24) /* revalidate once a day */
+#define FAVICON_MAX_AGE			(60 * 60 * 24 * 30)
+#define FAVICON_MAX_SIZE		(8 * 1024 * 1024)
+#define FAVICON_PLACEHOLDER		"applications-other"
+#define POLICY_SETTLE_DELAY		200 /* ms */
+
+static const gchar *phase_names[LAUNCHER_SYNC_N_PHASES] = {
+	"policy",
+	"launchers",
+	"publish",
+	"favicons",
+	"save"
+};
+
+
+/* everything one sync needs, owned by the worker thread */
+typedef struct
+{
+	FaviconCache             *favicon_cache;
+	GHashTable               *favicon_icons;
+	LauncherManifest         *manifest;
+	ProgramCache             *program_cache;
+	gboolean                  favicon_missing;
+
+	/* favicon url -> FaviconQueueEntry, fetched after publishing */
+	GHashTable               *favicon_queue;
+
+	/* the next CUSTOM_DIR is built here and swapped in as a whole */
+	gchar                    *staging_dir;
+	/* flock()ed while CUSTOM_DIR is written, -1 otherwise */
+	gint                      staging_lock;
+	/* what used to be CUSTOM_DIR, removed once the sync is done */
+	gchar                    *old_custom_dir;
+
+	GCancellable             *cancellable;
+	LauncherSyncResult        result;
+
+	GMainContext             *context;
+	LauncherSyncProgressFunc  progress_func;
+	gpointer                  progress_data;
+} LauncherSync;
+
+struct _LauncherSyncWatch
+{
+	gint                      ref_count;
+	gchar                    *policy_path;
+	GFileMonitor             *monitor;
+	GCancellable             *cancellable;
+
+	guint                     sync_id;
+	guint                     deadline_id;
+	gint                      timeout;
+	gboolean                  keep_watching;
+	gboolean                  syncing;
+	gboolean                  sync_pending;
+
+	LauncherSyncProgressFunc  progress_func;
+	gpointer                  progress_data;
+	LauncherSyncDoneFunc      done_func;
+	gpointer                  user_data;
+};
+
+typedef struct
+{
+	/* "id;/path/to/file.desktop" of every launcher showing the favicon */
+	GPtrArray                *launchers;
+	/* the launchers show FAVICON_PLACEHOLDER for now */
+	gboolean                  placeholder;
+} FaviconQueueEntry;
+
+typedef struct
+{
+	LauncherSyncProgressFunc  func;
+	gpointer                  data;
+	GCancellable             *cancellable;
+	LauncherSyncEvent         event;
+	gchar                    *desktop_file;
+	LauncherSyncResult        progress;
+} LauncherSyncProgress;
+
+
+static void
+favicon_queue_entry_free (FaviconQueueEntry *entry)
+{
+	g_ptr_array_free (entry->launchers, TRUE);
+	g_free (entry);
+}
+
+static void
+launcher_sync_progress_free (LauncherSyncProgress *progress)
+{
+	g_clear_object (&progress->cancellable);
+	g_free (progress->desktop_file);
+	g_free (progress);
+}
+
+static gboolean
+launcher_sync_progress_idle (gpointer user_data)
+{
+	LauncherSyncProgress *progress = (LauncherSyncProgress *)user_data;
+
+	/* the caller may be gone by now */
+	if (!g_cancellable_is_cancelled (progress->cancellable))
+		progress->func (progress->event, progress->desktop_file,
+                        &progress->progress, progress->data);
+
+	return FALSE;
+}
+
+static void
+launcher_sync_report (LauncherSync *sync, LauncherSyncEvent event, const gchar *desktop_file)
+{
+	LauncherSyncProgress *progress;
+
+	if (!sync->progress_func)
+		return;
+
+	/* hand over a copy, the worker keeps counting */
+	progress = g_new0 (LauncherSyncProgress, 1);
+	progress->func         = sync->progress_func;
+	progress->data         = sync->progress_data;
+	progress->cancellable  = sync->cancellable ? g_object_ref (sync->cancellable) : NULL;
+	progress->event        = event;
+	progress->desktop_file = g_strdup (desktop_file);
+	progress->progress     = sync->result;
+
+	g_main_context_invoke_full (sync->context, G_PRIORITY_DEFAULT,
+                                launcher_sync_progress_idle, progress,
+                                (GDestroyNotify) launcher_sync_progress_free);
+}
+
+/* Adds the time since *start to phase and starts the next one. */
+static void
+launcher_sync_phase_done (LauncherSync *sync, LauncherSyncPhase phase, gint64 *start)
+{
+	gint64 now = g_get_monotonic_time ();
+
+	sync->result.phase_time[phase] += now - *start;
+	*start = now;
+}
+
+static json_object *
+JSON_OBJECT_GET (json_object *root_obj, const char *key)
+{
+	if (!root_obj) return NULL;
+
+	json_object *ret_obj = NULL;
+
+	json_object_object_get_ex (root_obj, key, &ret_obj);
+
+	return ret_obj;
+}
+
+
+static gchar *
+get_grm_user_data (void)
+{
+	gchar *data = NULL, *file = NULL;
+
+	file = launcher_sync_get_policy_path ();
+
+	if (!g_file_test (file, G_FILE_TEST_EXISTS))
+		goto error;
+
+	g_file_get_contents (file, &data, NULL, NULL);
+
+error:
+	g_free (file);
+
+	return data;
+}
+
+static gchar *
+get_favicon_icon_name (const gchar *favicon_path)
+{
+	gchar *hash, *icon_name;
+
+	/* cached favicons are named after their content hash */
+	hash = g_path_get_basename (favicon_path);
+	icon_name = g_strdup_printf ("%s%s", FAVICON_ICON_PREFIX, hash);
+	g_free (hash);
+
+	return icon_name;
+}
+
+static gboolean
+install_favicon (GBytes *data, const gchar *icon_name)
+{
+	gboolean ret = FALSE;
+	GdkPixbuf *pixbuf = NULL;
+
+	pixbuf = favicon_image_decode (data, NULL);
+	if (pixbuf) {
+		ret = favicon_image_install (pixbuf, icon_name, NULL);
+		g_object_unref (pixbuf);
+	}
+
+	return ret;
+}
+
+static gboolean
+install_cached_favicon (const gchar *favicon_path, const gchar *icon_name)
+{
+	GBytes *data = NULL;
+	gboolean ret = FALSE;
+	GMappedFile *mapped = NULL;
+
+	mapped = g_mapped_file_new (favicon_path, FALSE, NULL);
+	if (mapped) {
+		data = g_mapped_file_get_bytes (mapped);
+		ret = install_favicon (data, icon_name);
+		g_bytes_unref (data);
+		g_mapped_file_unref (mapped);
+	}
+
+	return ret;
+}
+
+/* Points the Icon of an already published desktop file at icon_name. The
+ * file is replaced atomically, so DockbarX never reads half of it. */
+static void
+set_desktop_file_icon (LauncherSync *sync, const gchar *launcher, const gchar *icon_name)
+{
+	gsize len = 0;
+	GKeyFile *keyfile;
+	gchar *id = NULL, *icon = NULL;
+	gchar *data = NULL, *digest = NULL;
+	const gchar *dt_file_name;
+
+	dt_file_name = strchr (launcher, ';');
+	if (!dt_file_name)
+		return;
+
+	id = g_strndup (launcher, dt_file_name - launcher);
+	dt_file_name++;
+
+	keyfile = g_key_file_new ();
+	if (!g_key_file_load_from_file (keyfile, dt_file_name, G_KEY_FILE_KEEP_COMMENTS | G_KEY_FILE_KEEP_TRANSLATIONS, NULL))
+		goto out;
+
+	icon = g_key_file_get_string (keyfile, G_KEY_FILE_DESKTOP_GROUP, G_KEY_FILE_DESKTOP_KEY_ICON, NULL);
+	if (g_strcmp0 (icon, icon_name) == 0)
+		goto out;
+
+	g_key_file_set_string (keyfile, G_KEY_FILE_DESKTOP_GROUP, G_KEY_FILE_DESKTOP_KEY_ICON, icon_name);
+
+	data = g_key_file_to_data (keyfile, &len, NULL);
+	if (!g_file_set_contents (dt_file_name, data, len, NULL)) {
+		sync->result.n_errors++;
+		goto out;
+	}
+
+	/* the digest has to match what create_desktop_file() writes next time */
+	digest = g_compute_checksum_for_data (G_CHECKSUM_SHA256, (const guchar *)data, len);
+	launcher_manifest_set_entry (sync->manifest, id, digest, dt_file_name);
+
+	launcher_sync_report (sync, LAUNCHER_SYNC_EVENT_ICON_CHANGED, dt_file_name);
+
+out:
+	g_free (id);
+	g_free (icon);
+	g_free (data);
+	g_free (digest);
+	g_key_file_free (keyfile);
+}
+
+static void
+favicon_fetched_cb (const gchar              *url,
+                    const FaviconFetchResult *result,
+                    gpointer                  user_data)
+{
+	guint i;
+	gchar *favicon_path = NULL, *icon_name = NULL;
+	FaviconQueueEntry *entry;
+	LauncherSync *sync = (LauncherSync *)user_data;
+
+	entry = g_hash_table_lookup (sync->favicon_queue, url);
+
+	/* the sync was stopped, which is no failure of the server; the
+	 * placeholder is retried next time */
+	if (result->cancelled)
+		return;
+
+	/* the launchers already show the cached copy */
+	if (result->status == SOUP_STATUS_NOT_MODIFIED) {
+		favicon_cache_revalidated (sync->favicon_cache, url);
+		sync->result.n_icons_fetched++;
+		return;
+	}
+
+	/* on failure keep serving whatever copy we already have */
+	if (!result->body || g_bytes_get_size (result->body) == 0) {
+		sync->result.n_errors++;
+		return;
+	}
+
+	if (favicon_image_sniff (result->body) == FAVICON_IMAGE_UNKNOWN) {
+		favicon_cache_remove (sync->favicon_cache, url);
+		sync->result.n_errors++;
+		return;
+	}
+
+	favicon_path = favicon_cache_store (sync->favicon_cache, url, result->body,
+                                        result->etag, result->last_modified);
+	if (!favicon_path) {
+		sync->result.n_errors++;
+		return;
+	}
+
+	/* identical images share one set of normalized icons */
+	icon_name = get_favicon_icon_name (favicon_path);
+	if (favicon_image_is_installed (icon_name) ||
+        install_favicon (result->body, icon_name)) {
+		sync->result.n_icons_fetched++;
+		g_hash_table_add (sync->favicon_icons, g_strdup (icon_name));
+
+		for (i = 0; entry && i < entry->launchers->len; i++)
+			set_desktop_file_icon (sync, g_ptr_array_index (entry->launchers, i), icon_name);
+		if (entry)
+			entry->placeholder = FALSE;
+	} else {
+		favicon_cache_remove (sync->favicon_cache, url);
+		sync->result.n_errors++;
+	}
+
+	g_free (icon_name);
+	g_free (favicon_path);
+}
+
+static const gchar *
+get_favicon_url (json_object *dt_obj)
+{
+	const gchar *ret = NULL;
+
+	json_object_object_foreach (dt_obj, key, val) {
+		if (g_ascii_strcasecmp (key, "icon") == 0) {
+			const gchar *value = json_object_get_string (val);
+			if (g_str_has_prefix (value, "http://") || g_str_has_prefix (value, "https://"))
+				ret = value;
+			break;
+		}
+	}
+
+	return ret;
+}
+
+static void
+queue_favicon (LauncherSync *sync, const gchar *favicon_url, const gchar *id,
+               const gchar *dt_file_name, gboolean placeholder)
+{
+	FaviconQueueEntry *entry;
+
+	entry = g_hash_table_lookup (sync->favicon_queue, favicon_url);
+	if (!entry) {
+		entry = g_new0 (FaviconQueueEntry, 1);
+		entry->launchers = g_ptr_array_new_with_free_func (g_free);
+		g_hash_table_insert (sync->favicon_queue, g_strdup (favicon_url), entry);
+	}
+
+	g_ptr_array_add (entry->launchers, g_strdup_printf ("%s;%s", id, dt_file_name));
+	entry->placeholder |= placeholder;
+}
+
+/* Second phase of a sync: the launchers are out already, fetch the
+ * favicons they are waiting for and swap them in one by one. */
+static void
+update_favicons (LauncherSync *sync)
+{
+	GHashTableIter iter;
+	gpointer key, value;
+	FaviconFetcher *fetcher = NULL;
+
+	if (g_hash_table_size (sync->favicon_queue) == 0)
+		return;
+
+	fetcher = favicon_fetcher_new (FAVICON_MAX_CONCURRENT, FAVICON_TIMEOUT);
+
+	g_hash_table_iter_init (&iter, sync->favicon_queue);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		const gchar *favicon_url = (const gchar *)key;
+		gchar *etag = NULL, *last_modified = NULL;
+
+		favicon_cache_get_validators (sync->favicon_cache, favicon_url, &etag, &last_modified);
+		favicon_fetcher_add (fetcher, favicon_url, etag, last_modified,
+                             favicon_fetched_cb, sync, NULL);
+		g_free (etag);
+		g_free (last_modified);
+	}
+
+	favicon_fetcher_run (fetcher, sync->cancellable);
+	favicon_fetcher_free (fetcher);
+
+	/* placeholders left behind are retried on the next run */
+	g_hash_table_iter_init (&iter, sync->favicon_queue);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		if (((FaviconQueueEntry *)value)->placeholder)
+			sync->favicon_missing = TRUE;
+	}
+}
+
+static gchar *
+get_favicon (LauncherSync *sync, const gchar *favicon_url)
+{
+	gchar *favicon_path = NULL, *icon_name = NULL;
+
+	favicon_path = favicon_cache_lookup (sync->favicon_cache, favicon_url);
+	if (!favicon_path)
+		return NULL;
+
+	icon_name = get_favicon_icon_name (favicon_path);
+
+	/* the cache may outlive the normalized icons */
+	if (!favicon_image_is_installed (icon_name) &&
+        !install_cached_favicon (favicon_path, icon_name)) {
+		favicon_cache_remove (sync->favicon_cache, favicon_url);
+		g_clear_pointer (&icon_name, g_free);
+	}
+
+	g_free (favicon_path);
+
+	if (!icon_name)
+		return NULL;
+
+	g_hash_table_add (sync->favicon_icons, g_strdup (icon_name));
+
+	return icon_name;
+}
+
+
+static gchar *
+get_desktop_directory (LauncherSync *sync, json_object *obj)
+{
+	g_return_val_if_fail (obj != NULL, NULL);
+
+	gchar *desktop_dir = NULL;
+	const char *val = json_object_get_string (obj);
+
+	if (g_strcmp0 (val, "bar") == 0) {
+		desktop_dir = g_build_filename (g_get_user_data_dir (), CUSTOM_DIR, NULL);
+
+		/* comes into existence when the staging directory is swapped in */
+		if (sync->staging_dir)
+			return desktop_dir;
+	} else {
+		desktop_dir = g_build_filename (g_get_user_data_dir () ,"applications", NULL);
+	}
+
+	if (!g_file_test (desktop_dir, G_FILE_TEST_EXISTS)) {
+		if (g_mkdir_with_parents (desktop_dir, 0755) == -1) {
+			g_free (desktop_dir);
+			return NULL;
+		}
+	}
+
+	return desktop_dir;
+}
+
+/* Where a desktop file is actually written: files of CUSTOM_DIR go to
+ * the staging directory while it is being built. */
+static gchar *
+get_staged_file_name (LauncherSync *sync, const gchar *dt_file_name)
+{
+	gchar *dir, *name, *ret;
+	gchar *custom_dir;
+
+	if (!sync->staging_dir)
+		return g_strdup (dt_file_name);
+
+	dir = g_path_get_dirname (dt_file_name);
+	custom_dir = g_build_filename (g_get_user_data_dir (), CUSTOM_DIR, NULL);
+
+	if (g_str_equal (dir, custom_dir)) {
+		name = g_path_get_basename (dt_file_name);
+		ret = g_build_filename (sync->staging_dir, name, NULL);
+		g_free (name);
+	} else {
+		ret = g_strdup (dt_file_name);
+	}
+
+	g_free (dir);
+	g_free (custom_dir);
+
+	return ret;
+}
+
+static void
+cleanup_favicon_files (void)
+{
+	GDir *dir;
+	const gchar *name;
+
+	/* favicons used to be stored as ~/.cache/favicon-NN */
+	dir = g_dir_open (g_get_user_cache_dir (), 0, NULL);
+	if (!dir)
+		return;
+
+	while ((name = g_dir_read_name (dir)) != NULL) {
+		if (g_str_has_prefix (name, "favicon-")) {
+			gchar *path = g_build_filename (g_get_user_cache_dir (), name, NULL);
+			g_unlink (path);
+			g_free (path);
+		}
+	}
+
+	g_dir_close (dir);
+}
+
+static void
+remove_directory (const gchar *path)
+{
+	GDir *dir;
+	const gchar *name;
+
+	dir = g_dir_open (path, 0, NULL);
+	if (dir) {
+		while ((name = g_dir_read_name (dir)) != NULL) {
+			gchar *file = g_build_filename (path, name, NULL);
+			g_unlink (file);
+			g_free (file);
+		}
+		g_dir_close (dir);
+	}
+
+	g_rmdir (path);
+}
+
+static void
+cleanup_staging_directories (void)
+{
+	GDir *dir;
+	const gchar *name;
+
+	/* left behind by a sync that did not get to finish; the caller holds
+	 * STAGING_LOCK, so none of them is being built right now */
+	dir = g_dir_open (g_get_user_data_dir (), 0, NULL);
+	if (!dir)
+		return;
+
+	while ((name = g_dir_read_name (dir)) != NULL) {
+		if (g_str_has_prefix (name, "." PACKAGE_NAME "-")) {
+			gchar *path = g_build_filename (g_get_user_data_dir (), name, NULL);
+			remove_directory (path);
+			g_free (path);
+		}
+	}
+
+	g_dir_close (dir);
+}
+
+/* Syncs running side by side, like the helper's --watch next to the
+ * applet, take turns at writing CUSTOM_DIR. The lock goes away with the
+ * process, so a crashed sync never blocks the next one. */
+static gboolean
+lock_staging (LauncherSync *sync)
+{
+	gint fd;
+	gchar *path;
+
+	path = g_build_filename (g_get_user_data_dir (), STAGING_LOCK, NULL);
+	fd = open (path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+	g_free (path);
+
+	if (fd == -1)
+		return FALSE;
+
+	while (flock (fd, LOCK_EX) == -1) {
+		if (errno != EINTR) {
+			close (fd);
+			return FALSE;
+		}
+	}
+
+	sync->staging_lock = fd;
+
+	return TRUE;
+}
+
+static void
+unlock_staging (LauncherSync *sync)
+{
+	if (sync->staging_lock == -1)
+		return;
+
+	/* closing drops the flock() */
+	close (sync->staging_lock);
+	sync->staging_lock = -1;
+}
+
+static void
+create_staging_directory (LauncherSync *sync)
+{
+	gchar *template;
+
+	cleanup_staging_directories ();
+
+	/* next to applications/, so that renaming it into place stays
+	 * on one file system, but outside of what GIO scans */
+	template = g_build_filename (g_get_user_data_dir (), "." PACKAGE_NAME "-XXXXXX", NULL);
+	if (g_mkdtemp_full (template, 0755)) {
+		sync->staging_dir = template;
+	} else {
+		/* fall back to writing CUSTOM_DIR in place */
+		g_warning ("Could not create staging directory: %s", g_strerror (errno));
+		g_free (template);
+	}
+}
+
+/* Whether the "bar" launchers of the policy are a different set of files
+ * than CUSTOM_DIR holds. Only then is the directory rebuilt and swapped,
+ * otherwise its files are updated one by one like the others. */
+static gboolean
+custom_set_changed (json_object *desktop_info)
+{
+	GDir *dir;
+	gint i, len;
+	guint n_files = 0;
+	const gchar *name;
+	gboolean ret = FALSE;
+	gchar *custom_dir;
+	GHashTable *names;
+	json_object *apps_obj;
+
+	names = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	apps_obj = desktop_info ? JSON_OBJECT_GET (desktop_info, "apps") : NULL;
+	len = apps_obj ? json_object_array_length (apps_obj) : 0;
+	for (i = 0; i < len; i++) {
+		json_object *app_obj = json_object_array_get_idx (apps_obj, i);
+		json_object *pos_obj, *ord_obj;
+
+		if (!app_obj || !JSON_OBJECT_GET (app_obj, "desktop"))
+			continue;
+
+		pos_obj = JSON_OBJECT_GET (app_obj, "position");
+		ord_obj = JSON_OBJECT_GET (app_obj, "order");
+		if (g_strcmp0 (json_object_get_string (pos_obj), "bar") == 0)
+			g_hash_table_add (names, g_strdup_printf ("shortcut-%.02d.desktop",
+                                                      json_object_get_int (ord_obj) - 1));
+	}
+
+	custom_dir = g_build_filename (g_get_user_data_dir (), CUSTOM_DIR, NULL);
+	dir = g_dir_open (custom_dir, 0, NULL);
+	if (dir) {
+		while (!ret && (name = g_dir_read_name (dir)) != NULL) {
+			if (!g_str_has_suffix (name, ".desktop"))
+				continue;
+			ret = !g_hash_table_contains (names, name);
+			n_files++;
+		}
+		g_dir_close (dir);
+	}
+
+	ret = ret || (n_files != g_hash_table_size (names));
+
+	g_free (custom_dir);
+	g_hash_table_destroy (names);
+
+	return ret;
+}
+
+/* Makes the entries of a directory durable; errno is set on failure. */
+static gboolean
+fsync_directory (const gchar *path)
+{
+	gint fd, saved_errno;
+
+	fd = open (path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd == -1)
+		return FALSE;
+
+	if (fsync (fd) == -1) {
+		saved_errno = errno;
+		close (fd);
+		errno = saved_errno;
+		return FALSE;
+	}
+
+	close (fd);
+
+	return TRUE;
+}
+
+/* Puts the staging directory in place of CUSTOM_DIR with a single rename,
+ * so that desktop file monitors see one change and a crash never leaves a
+ * half written directory behind. */
+static gboolean
+swap_custom_directory (LauncherSync *sync)
+{
+	gint saved_errno = 0;
+	gboolean ret = FALSE;
+	gchar *custom_dir = NULL, *parent_dir = NULL;
+
+	if (!sync->staging_dir)
+		return TRUE;
+
+	custom_dir = g_build_filename (g_get_user_data_dir (), CUSTOM_DIR, NULL);
+	parent_dir = g_path_get_dirname (custom_dir);
+	g_mkdir_with_parents (parent_dir, 0755);
+
+	/* the staged files were written durably, their names must be too
+	 * before they replace the old ones */
+	if (!fsync_directory (sync->staging_dir)) {
+		g_warning ("Could not flush %s: %s", sync->staging_dir, g_strerror (errno));
+		goto out;
+	}
+
+	if (renameat2 (AT_FDCWD, sync->staging_dir, AT_FDCWD, custom_dir, RENAME_EXCHANGE) == 0) {
+		/* the staging path now holds the old files */
+		sync->old_custom_dir = g_steal_pointer (&sync->staging_dir);
+		ret = TRUE;
+	} else if (errno == ENOENT) {
+		ret = (g_rename (sync->staging_dir, custom_dir) == 0);
+		if (!ret)
+			saved_errno = errno;
+	} else {
+		/* file systems without RENAME_EXCHANGE get a short window
+		 * without CUSTOM_DIR instead of a half written one */
+		gchar *old_dir = g_strdup_printf ("%s.old", sync->staging_dir);
+
+		if (g_rename (custom_dir, old_dir) == 0) {
+			ret = (g_rename (sync->staging_dir, custom_dir) == 0);
+			if (ret) {
+				sync->old_custom_dir = g_steal_pointer (&old_dir);
+			} else {
+				saved_errno = errno;
+				if (g_rename (old_dir, custom_dir) != 0)
+					g_warning ("Could not restore %s from %s: %s",
+                               custom_dir, old_dir, g_strerror (errno));
+			}
+		} else {
+			saved_errno = errno;
+		}
+
+		g_free (old_dir);
+	}
+
+	if (!ret) {
+		g_warning ("Could not replace %s: %s", custom_dir, g_strerror (saved_errno));
+		goto out;
+	}
+
+	/* the swap itself happened, only a crash could still undo it */
+	if (!fsync_directory (parent_dir)) {
+		g_warning ("Could not flush %s: %s", parent_dir, g_strerror (errno));
+		sync->result.n_errors++;
+	}
+
+out:
+	g_free (custom_dir);
+	g_free (parent_dir);
+
+	return ret;
+}
+
+/* Picks the first runnable candidate of a ",,,"-separated Exec value.
+ * Returns FALSE when the entry has an Exec but nothing in it can be run. */
+static gboolean
+resolve_desktop_exec (LauncherSync *sync, json_object *obj, gchar **exec)
+{
+	gboolean ret = TRUE;
+
+	*exec = NULL;
+
+	json_object_object_foreach (obj, key, val) {
+		if (g_ascii_strcasecmp (key, "exec") != 0)
+			continue;
+
+		gint i = 0;
+		gchar **s_exec = g_strsplit (json_object_get_string (val), ",,,", -1);
+
+		ret = FALSE;
+		for (i = 0; s_exec[i] != NULL; i++) {
+			if (program_cache_exec_exists (sync->program_cache, s_exec[i])) {
+				*exec = g_strdup (s_exec[i]);
+				ret = TRUE;
+				break;
+			}
+		}
+		g_strfreev (s_exec);
+		break;
+	}
+
+	return ret;
+}
+
+static gboolean
+create_desktop_file (LauncherSync *sync, json_object *obj, const gchar *exec, const gchar *id, const gchar *dt_file_name)
+{
+    g_return_val_if_fail ((obj != NULL) || (dt_file_name != NULL), FALSE);
+
+    gsize len = 0;
+    gboolean ret = FALSE;
+    gchar *data = NULL, *digest = NULL;
+    gchar *staged_file_name = NULL;
+    GKeyFile *keyfile = NULL;
+
+    keyfile = g_key_file_new ();
+    staged_file_name = get_staged_file_name (sync, dt_file_name);
+
+    json_object_object_foreach (obj, key, val) {
+        const gchar *value = json_object_get_string (val);
+        gchar *d_key = g_ascii_strdown (key, -1);
+
+        if (d_key && g_strcmp0 (d_key, "exec") == 0 && exec) {
+            value = exec;
+        }
+
+        if (d_key && g_strcmp0 (d_key, "icon") == 0) {
+            if (g_str_has_prefix (value, "http://") || g_str_has_prefix (value, "https://")) {
+                gchar *icon_file = get_favicon (sync, value);
+
+                /* never wait for the network here, stale or missing
+                 * favicons are fetched once the launchers are out */
+                if (!icon_file || !favicon_cache_is_fresh (sync->favicon_cache, value, FAVICON_TTL))
+                    queue_favicon (sync, value, id, dt_file_name, icon_file == NULL);
+
+                g_key_file_set_string (keyfile, "Desktop Entry", "Icon", icon_file ? icon_file : FAVICON_PLACEHOLDER);
+                g_free (icon_file);
+            } else {
+                g_key_file_set_string (keyfile, "Desktop Entry", "Icon", value);
+            }
+        } else {
+            gchar *new_key = NULL;
+
+            if (g_strcmp0 (d_key, "name") == 0) {
+                new_key = g_strdup ("Name");
+            } else if (g_strcmp0 (d_key, "comment") == 0) {
+                new_key = g_strdup ("Comment");
+            } else if (g_strcmp0 (d_key, "exec") == 0) {
+                new_key = g_strdup ("Exec");
+            }
+
+            if (new_key) {
+                g_key_file_set_string (keyfile, "Desktop Entry", new_key, value);
+                g_free (new_key);
+            }
+        }
+
+        g_free (d_key);
+    }
+
+    g_key_file_set_string (keyfile, "Desktop Entry", "Type", "Application");
+    g_key_file_set_string (keyfile, "Desktop Entry", "Terminal", "false");
+    g_key_file_set_string (keyfile, "Desktop Entry", "StartupNotify", "true");
+    /* we don't want to show in application launcher */
+    g_key_file_set_string (keyfile, "Desktop Entry", "NoDisplay", "true");
+
+    data = g_key_file_to_data (keyfile, &len, NULL);
+    digest = g_compute_checksum_for_data (G_CHECKSUM_SHA256, (const guchar *)data, len);
+
+    if (sync->staging_dir && !g_str_equal (staged_file_name, dt_file_name)) {
+        /* the whole directory is replaced at once; the staging
+         * directory is new, so the file needs no temporary copy */
+        ret = g_file_set_contents_full (staged_file_name, data, len,
+                                        G_FILE_SET_CONTENTS_DURABLE, 0644, NULL);
+    } else if (launcher_manifest_entry_matches (sync->manifest, id, digest, dt_file_name)) {
+        /* leave unchanged files alone so that desktop file monitors stay quiet */
+        ret = TRUE;
+    } else {
+        ret = g_file_set_contents (dt_file_name, data, len, NULL);
+    }
+
+    if (ret)
+        launcher_manifest_set_entry (sync->manifest, id, digest, dt_file_name);
+
+    g_free (data);
+    g_free (digest);
+    g_free (staged_file_name);
+    g_key_file_free (keyfile);
+
+    return ret;
+}
+
+static void
+launchers_set (GSList *launchers, GSettings *dockbarx_settings)
+{
+	if (!dockbarx_settings)
+		return;
+
+	if (launchers && g_slist_length (launchers) > 0) {
+		guint i = 0;
+		gboolean changed = FALSE;
+		gchar **old_launchers = NULL;
+		GPtrArray *array;
+
+		array = g_ptr_array_new ();
+
+		GSList *l = NULL;
+		for (l = launchers; l; l = l->next) {
+			g_ptr_array_add (array, l->data);
+		}
+		g_ptr_array_add (array, NULL);
+
+		old_launchers = g_settings_get_strv (dockbarx_settings, "launchers");
+
+		changed = (g_strv_length (old_launchers) != array->len - 1);
+		for (i = 0; !changed && old_launchers[i] != NULL; i++)
+			changed = !g_str_equal (old_launchers[i], g_ptr_array_index (array, i));
+
+		/* nothing to tell the dock about */
+		if (changed) {
+			g_settings_delay (dockbarx_settings);
+			g_settings_set_strv (dockbarx_settings, "launchers", (const gchar * const *)array->pdata);
+			g_settings_apply (dockbarx_settings);
+
+			/* make sure dconf got the write before we report back */
+			g_settings_sync ();
+		}
+
+		g_strfreev (old_launchers);
+		g_ptr_array_free (array, TRUE);
+	}
+}
+
+static GSList *
+dockbarx_launchers_get (GSettings *dockbarx_settings)
+{
+	GSList *ret = NULL;
+
+	if (!dockbarx_settings)
+		return NULL;
+
+	guint i;
+	gchar **launchers;
+
+	launchers = g_settings_get_strv (dockbarx_settings, "launchers");
+	for (i = 0; i < g_strv_length (launchers); i++) {
+		if (!g_str_has_prefix (launchers[i], "shortcut-"))
+			ret = g_slist_append (ret, g_strdup (launchers[i]));
+	}
+
+	g_strfreev (launchers);
+
+	return ret;
+}
+
+static GSList *
+get_launchers_from_online (LauncherSync *sync, json_object *root_obj)
+{
+	if (!root_obj)
+		return NULL;
+
+	GSList *launchers = NULL;
+	json_object *apps_obj = NULL;
+
+	apps_obj = JSON_OBJECT_GET (root_obj, "apps");
+	if (apps_obj) {
+		gint i = 0, len = 0;
+
+		len = json_object_array_length (apps_obj);
+		for (i = 0; i < len; i++) {
+			json_object *app_obj = json_object_array_get_idx (apps_obj, i);
+
+			if (g_cancellable_is_cancelled (sync->cancellable))
+				break;
+
+			if (app_obj) {
+				json_object *dt_obj = NULL, *pos_obj = NULL, *ord_obj = NULL;
+				dt_obj = JSON_OBJECT_GET (app_obj, "desktop");
+				pos_obj = JSON_OBJECT_GET (app_obj, "position");
+				ord_obj = JSON_OBJECT_GET (app_obj, "order");
+
+				if (dt_obj && pos_obj) {
+					gchar *exec = NULL;
+
+					/* do not publish launchers that cannot be started */
+					if (!resolve_desktop_exec (sync, dt_obj, &exec)) {
+						g_message ("Skipping launcher %d, no runnable Exec", json_object_get_int (ord_obj));
+						sync->result.n_errors++;
+						continue;
+					}
+
+					gchar *dt_dir_name = get_desktop_directory (sync, pos_obj);
+					if (dt_dir_name) {
+						gint order = json_object_get_int(ord_obj);
+						gchar *id = g_strdup_printf ("shortcut-%.02d", order-1);
+						gchar *dt_file_name = g_strdup_printf ("%s/%s.desktop", dt_dir_name, id);
+
+						if (create_desktop_file (sync, dt_obj, exec, id, dt_file_name)) {
+							gchar *launcher = g_strdup_printf ("%s;%s", id, dt_file_name);
+							launchers = g_slist_insert (launchers, launcher, order-1);
+						} else {
+							g_warning ("Could not create desktop file : %s", dt_file_name);
+							sync->result.n_errors++;
+						}
+
+						g_free (id);
+						g_free (dt_file_name);
+						g_free (dt_dir_name);
+					}
+
+					g_free (exec);
+
+					launcher_sync_report (sync, LAUNCHER_SYNC_EVENT_PROGRESS, NULL);
+				}
+			}
+		}
+	}
+
+	return launchers;
+}
+
+/* First phase of a sync: desktop files for every launcher, using the
+ * favicons at hand */
+static GSList *
+get_launchers_from_policy (LauncherSync *sync, const gchar *data)
+{
+	GSList *launchers = NULL;
+
+	sync->favicon_missing = FALSE;
+
+	if (launcher_manifest_is_empty (sync->manifest))
+		cleanup_favicon_files ();
+
+	gchar *cache_dir = g_build_filename (g_get_user_cache_dir (), PACKAGE_NAME, NULL);
+	sync->favicon_cache = favicon_cache_new (cache_dir);
+	sync->favicon_icons = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	sync->favicon_queue = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                                 (GDestroyNotify) favicon_queue_entry_free);
+	sync->program_cache = program_cache_new ();
+	g_free (cache_dir);
+
+	/* held until CUSTOM_DIR is complete again */
+	if (!lock_staging (sync))
+		g_warning ("Could not lock %s: %s", STAGING_LOCK, g_strerror (errno));
+
+	if (data) {
+		enum json_tokener_error jerr = json_tokener_success;
+		json_object *root_obj = json_tokener_parse_verbose (data, &jerr);
+		if (jerr == json_tokener_success) {
+			json_object *obj1 = NULL, *obj2= NULL;
+			obj1 = JSON_OBJECT_GET (root_obj, "data");
+			obj2 = JSON_OBJECT_GET (obj1, "desktopInfo");
+
+			/* without the lock, staging could race another sync */
+			if (sync->staging_lock != -1 && custom_set_changed (obj2))
+				create_staging_directory (sync);
+
+			launchers = get_launchers_from_online (sync, obj2);
+			json_object_put (root_obj);
+		}
+	}
+
+	/* a cancelled or failed sync leaves CUSTOM_DIR as it was */
+	if (g_cancellable_is_cancelled (sync->cancellable) || !swap_custom_directory (sync)) {
+		if (sync->staging_dir) {
+			remove_directory (sync->staging_dir);
+			if (!g_cancellable_is_cancelled (sync->cancellable))
+				sync->result.n_errors++;
+		}
+		g_clear_pointer (&sync->staging_dir, g_free);
+	}
+
+	unlock_staging (sync);
+
+	return launchers;
+}
+
+static void
+update_icon_atlas (LauncherSync *sync)
+{
+	gchar *atlas_dir;
+	GError *error = NULL;
+
+	atlas_dir = g_build_filename (g_get_user_cache_dir (), PACKAGE_NAME, "icon-atlas", NULL);
+
+	/* without the tool the plug decodes the PNGs as before */
+	if (!favicon_image_update_atlas (atlas_dir, sync->favicon_icons, &error)) {
+		if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
+			g_debug ("Icon atlas not built: %s", error->message);
+		else
+			g_warning ("Could not update the icon atlas: %s", error->message);
+		g_error_free (error);
+	}
+
+	g_free (atlas_dir);
+}
+
+static void
+save_launchers_from_policy (LauncherSync *sync, GSList *launchers, const gchar *policy_digest)
+{
+	/* a partial sync must not look current next time */
+	if (!g_cancellable_is_cancelled (sync->cancellable)) {
+		/* drop the desktop files of launchers that left the policy */
+		launcher_manifest_prune (sync->manifest);
+
+		/* favicons are revalidated at the latest when the manifest expires,
+		 * and right away on the next run if one of them could not be fetched */
+		launcher_manifest_set_policy (sync->manifest, policy_digest,
+                                      sync->favicon_missing ? 0 : g_get_real_time () / G_USEC_PER_SEC + FAVICON_TTL,
+                                      launchers);
+		launcher_manifest_save (sync->manifest);
+
+		favicon_image_prune (sync->favicon_icons);
+		update_icon_atlas (sync);
+		favicon_cache_gc (sync->favicon_cache, FAVICON_MAX_AGE, FAVICON_MAX_SIZE);
+	}
+
+	favicon_cache_save (sync->favicon_cache);
+	g_clear_pointer (&sync->favicon_cache, favicon_cache_free);
+	g_clear_pointer (&sync->favicon_icons, g_hash_table_destroy);
+	g_clear_pointer (&sync->favicon_queue, g_hash_table_destroy);
+	g_clear_pointer (&sync->program_cache, program_cache_free);
+}
+
+static void
+publish_launcher_table (LauncherSync *sync, GSList *launchers)
+{
+	gchar *path;
+	GError *error = NULL;
+
+	/* only kept up to date while a fallback strip reads it, the strip
+	 * writes the first one */
+	path = launcher_table_get_path ();
+	if (!g_file_test (path, G_FILE_TEST_EXISTS)) {
+		g_free (path);
+		return;
+	}
+
+	if (!launcher_table_update (path, launchers, &error)) {
+		g_warning ("Could not write the launcher table: %s", error->message);
+		g_error_free (error);
+		sync->result.n_errors++;
+	}
+	g_free (path);
+}
+
+static GSList *
+get_launchers (GSList *new_launchers, GSettings *dockbarx_settings)
+{
+	GSList *cmb_launchers = NULL;
+	GSList *old_launchers = NULL;
+
+	old_launchers = dockbarx_launchers_get (dockbarx_settings);
+
+	cmb_launchers = launcher_index_merge (old_launchers, new_launchers);
+
+	g_slist_free_full (old_launchers, (GDestroyNotify) g_free);
+
+	return cmb_launchers;
+}
+
+static gboolean
+launcher_sync_run (LauncherSync *sync, GError **error)
+{
+	GSList *launchers = NULL;
+	GSList *new_launchers = NULL;
+	gchar *data = NULL;
+	gchar *policy_digest = NULL, *manifest_path = NULL;
+	GSettingsSchema *schema = NULL;
+	GSettings *dockbarx_settings = NULL;
+	gint64 start = g_get_monotonic_time ();
+
+	data = get_grm_user_data ();
+	if (!data) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                             "No launcher policy has been written yet");
+		return FALSE;
+	}
+
+	schema = g_settings_schema_source_lookup (g_settings_schema_source_get_default (),
+                                              "org.dockbarx", TRUE);
+	if (schema) {
+		dockbarx_settings = g_settings_new_full (schema, NULL, NULL);
+		g_settings_schema_unref (schema);
+	}
+
+	policy_digest = g_compute_checksum_for_string (G_CHECKSUM_SHA256, data, -1);
+
+	manifest_path = g_build_filename (g_get_user_cache_dir (), PACKAGE_NAME, "launchers.manifest", NULL);
+	sync->manifest = launcher_manifest_load (manifest_path);
+	g_free (manifest_path);
+
+	if (launcher_manifest_is_current (sync->manifest, policy_digest, g_get_real_time () / G_USEC_PER_SEC)) {
+		/* the policy did not change since the last sync */
+		new_launchers = launcher_manifest_get_launchers (sync->manifest);
+		sync->result.n_apps = g_slist_length (new_launchers);
+		sync->result.unchanged = TRUE;
+		launcher_sync_phase_done (sync, LAUNCHER_SYNC_PHASE_POLICY, &start);
+	} else {
+		launcher_sync_phase_done (sync, LAUNCHER_SYNC_PHASE_POLICY, &start);
+		new_launchers = get_launchers_from_policy (sync, data);
+		launcher_sync_phase_done (sync, LAUNCHER_SYNC_PHASE_LAUNCHERS, &start);
+	}
+
+	/* never publish half a policy */
+	if (!g_cancellable_is_cancelled (sync->cancellable)) {
+		launchers = get_launchers (new_launchers, dockbarx_settings);
+		/* the table goes first, so it is current once the key changes */
+		publish_launcher_table (sync, launchers);
+		launchers_set (launchers, dockbarx_settings);
+		launcher_sync_phase_done (sync, LAUNCHER_SYNC_PHASE_PUBLISH, &start);
+		launcher_sync_report (sync, LAUNCHER_SYNC_EVENT_PUBLISHED, NULL);
+	}
+
+	if (!sync->result.unchanged) {
+		if (!g_cancellable_is_cancelled (sync->cancellable))
+			update_favicons (sync);
+		launcher_sync_phase_done (sync, LAUNCHER_SYNC_PHASE_FAVICONS, &start);
+		save_launchers_from_policy (sync, new_launchers, policy_digest);
+
+		/* favicons may have replaced some icons since */
+		if (!g_cancellable_is_cancelled (sync->cancellable))
+			publish_launcher_table (sync, launchers);
+	}
+
+	/* nobody waits for the old desktop files any more */
+	if (sync->old_custom_dir) {
+		remove_directory (sync->old_custom_dir);
+		g_clear_pointer (&sync->old_custom_dir, g_free);
+	}
+
+	launcher_sync_phase_done (sync, LAUNCHER_SYNC_PHASE_SAVE, &start);
+
+	g_slist_free_full (new_launchers, (GDestroyNotify) g_free);
+	g_slist_free_full (launchers, (GDestroyNotify) g_free);
+	g_clear_pointer (&sync->manifest, launcher_manifest_free);
+
+	g_free (data);
+	g_free (policy_digest);
+
+	if (dockbarx_settings)
+		g_object_unref (dockbarx_settings);
+
+	return !g_cancellable_set_error_if_cancelled (sync->cancellable, error);
+}
+
+static void
+launcher_sync_free (LauncherSync *sync)
+{
+	g_clear_object (&sync->cancellable);
+	g_main_context_unref (sync->context);
+	g_free (sync);
+}
+
+static void
+launcher_sync_thread (GTask        *task,
+                      gpointer      source_object,
+                      gpointer      task_data,
+                      GCancellable *cancellable)
+{
+	GError *error = NULL;
+	GMainContext *context;
+	LauncherSync *sync = (LauncherSync *)task_data;
+
+	/* favicon downloads run a main loop of their own, keep it
+	 * away from the caller's context */
+	context = g_main_context_new ();
+	g_main_context_push_thread_default (context);
+
+	if (launcher_sync_run (sync, &error))
+		g_task_return_boolean (task, TRUE);
+	else
+		g_task_return_error (task, error);
+
+	g_main_context_pop_thread_default (context);
+	g_main_context_unref (context);
+}
+
+gchar *
+launcher_sync_get_policy_path (void)
+{
+	return g_build_filename (g_get_home_dir (), ".gooroom", GRM_USER, NULL);
+}
+
+void
+launcher_sync_async (GCancellable             *cancellable,
+                     LauncherSyncProgressFunc  progress_func,
+                     gpointer                  progress_data,
+                     GAsyncReadyCallback       callback,
+                     gpointer                  user_data)
+{
+	GTask *task;
+	LauncherSync *sync;
+
+	sync = g_new0 (LauncherSync, 1);
+	sync->staging_lock  = -1;
+	sync->cancellable   = cancellable ? g_object_ref (cancellable) : NULL;
+	sync->context       = g_main_context_ref_thread_default ();
+	sync->progress_func = progress_func;
+	sync->progress_data = progress_data;
+
+	task = g_task_new (NULL, cancellable, callback, user_data);
+	g_task_set_source_tag (task, launcher_sync_async);
+	g_task_set_task_data (task, sync, (GDestroyNotify) launcher_sync_free);
+	g_task_run_in_thread (task, launcher_sync_thread);
+	g_object_unref (task);
+}
+
+gboolean
+launcher_sync_finish (GAsyncResult        *result,
+                      LauncherSyncResult  *sync_result,
+                      GError             **error)
+{
+	LauncherSync *sync;
+
+	g_return_val_if_fail (g_task_is_valid (result, NULL), FALSE);
+
+	sync = g_task_get_task_data (G_TASK (result));
+	if (sync_result)
+		*sync_result = sync->result;
+
+	return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+const gchar *
+launcher_sync_phase_get_name (LauncherSyncPhase phase)
+{
+	g_return_val_if_fail (phase < LAUNCHER_SYNC_N_PHASES, NULL);
+
+	return phase_names[phase];
+}
+
+void
+launcher_sync_result_log (const LauncherSyncResult *sync_result)
+{
+	guint i, n_fields = 0;
+	gchar *message;
+	gchar *values[4 + LAUNCHER_SYNC_N_PHASES];
+	gchar *keys[LAUNCHER_SYNC_N_PHASES];
+	GLogField fields[5 + LAUNCHER_SYNC_N_PHASES];
+
+	g_return_if_fail (sync_result != NULL);
+
+	message = g_strdup_printf ("Synced %u launchers%s, %u favicons fetched, %u errors",
+                               sync_result->n_apps, sync_result->unchanged ? " (unchanged)" : "",
+                               sync_result->n_icons_fetched, sync_result->n_errors);
+
+	values[0] = g_strdup_printf ("%u", sync_result->n_apps);
+	values[1] = g_strdup_printf ("%u", sync_result->n_icons_fetched);
+	values[2] = g_strdup_printf ("%u", sync_result->n_errors);
+	values[3] = g_strdup (sync_result->unchanged ? "1" : "0");
+
+	fields[n_fields++] = (GLogField) { "MESSAGE", message, -1 };
+	fields[n_fields++] = (GLogField) { "GOOROOM_SYNC_APPS", values[0], -1 };
+	fields[n_fields++] = (GLogField) { "GOOROOM_SYNC_ICONS_FETCHED", values[1], -1 };
+	fields[n_fields++] = (GLogField) { "GOOROOM_SYNC_ERRORS", values[2], -1 };
+	fields[n_fields++] = (GLogField) { "GOOROOM_SYNC_UNCHANGED", values[3], -1 };
+
+	/* GOOROOM_SYNC_POLICY_USEC, ... */
+	for (i = 0; i < LAUNCHER_SYNC_N_PHASES; i++) {
+		gchar *name = g_ascii_strup (phase_names[i], -1);
+
+		keys[i] = g_strdup_printf ("GOOROOM_SYNC_%s_USEC", name);
+		values[4 + i] = g_strdup_printf ("%" G_GINT64_FORMAT, sync_result->phase_time[i]);
+		fields[n_fields++] = (GLogField) { keys[i], values[4 + i], -1 };
+		g_free (name);
+	}
+
+	g_log_structured_array (G_LOG_LEVEL_MESSAGE, fields, n_fields);
+
+	for (i = 0; i < G_N_ELEMENTS (values); i++)
+		g_free (values[i]);
+	for (i = 0; i < G_N_ELEMENTS (keys); i++)
+		g_free (keys[i]);
+	g_free (message);
+}
+
+static void
+launcher_sync_watch_unref (LauncherSyncWatch *watch)
+{
+	if (--watch->ref_count > 0)
+		return;
+
+	g_object_unref (watch->cancellable);
+	g_free (watch->policy_path);
+	g_free (watch);
+}
+
+/* No more waiting, and no more watching. */
+static void
+launcher_sync_watch_unwatch (LauncherSyncWatch *watch)
+{
+	if (watch->sync_id > 0) {
+		g_source_remove (watch->sync_id);
+		watch->sync_id = 0;
+	}
+
+	if (watch->deadline_id > 0) {
+		g_source_remove (watch->deadline_id);
+		watch->deadline_id = 0;
+	}
+
+	if (watch->monitor) {
+		g_signal_handlers_disconnect_by_data (watch->monitor, watch);
+		g_file_monitor_cancel (watch->monitor);
+		g_clear_object (&watch->monitor);
+	}
+}
+
+static gboolean launcher_sync_watch_sync (gpointer user_data);
+
+static void
+launcher_sync_watch_done_cb (GObject      *source_object,
+                             GAsyncResult *res,
+                             gpointer      user_data)
+{
+	GError *error = NULL;
+	LauncherSyncResult result;
+	LauncherSyncWatch *watch = (LauncherSyncWatch *)user_data;
+
+	watch->syncing = FALSE;
+
+	if (launcher_sync_finish (res, &result, &error)) {
+		if (watch->done_func)
+			watch->done_func (&result, NULL, watch->user_data);
+	} else {
+		if (watch->done_func)
+			watch->done_func (NULL, error, watch->user_data);
+		g_error_free (error);
+	}
+
+	/* the policy changed again while it was synced */
+	if (watch->sync_pending && watch->monitor) {
+		watch->sync_pending = FALSE;
+		watch->sync_id = g_idle_add (launcher_sync_watch_sync, watch);
+	} else if (!watch->keep_watching) {
+		launcher_sync_watch_unwatch (watch);
+	}
+
+	launcher_sync_watch_unref (watch);
+}
+
+static gboolean
+launcher_sync_watch_sync (gpointer user_data)
+{
+	LauncherSyncWatch *watch = (LauncherSyncWatch *)user_data;
+
+	watch->sync_id = 0;
+
+	/* change events keep coming in while a sync runs in the
+	 * background; remember them for afterwards */
+	if (watch->syncing) {
+		watch->sync_pending = TRUE;
+		return FALSE;
+	}
+
+	/* removed again before we got to it, wait for the next event */
+	if (!g_file_test (watch->policy_path, G_FILE_TEST_EXISTS))
+		return FALSE;
+
+	if (watch->deadline_id > 0) {
+		g_source_remove (watch->deadline_id);
+		watch->deadline_id = 0;
+	}
+
+	watch->syncing = TRUE;
+	watch->ref_count++;
+	launcher_sync_async (watch->cancellable,
+                         watch->progress_func, watch->progress_data,
+                         launcher_sync_watch_done_cb, watch);
+
+	return FALSE;
+}
+
+static void
+launcher_sync_watch_changed_cb (GFileMonitor      *monitor,
+                                GFile             *file,
+                                GFile             *other_file,
+                                GFileMonitorEvent  event_type,
+                                gpointer           user_data)
+{
+	LauncherSyncWatch *watch = (LauncherSyncWatch *)user_data;
+
+	switch (event_type) {
+	case G_FILE_MONITOR_EVENT_CREATED:
+	case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+	case G_FILE_MONITOR_EVENT_MOVED_IN:
+	case G_FILE_MONITOR_EVENT_RENAMED:
+		/* agents tend to write the file in several steps */
+		if (watch->sync_id > 0)
+			g_source_remove (watch->sync_id);
+		watch->sync_id = g_timeout_add (POLICY_SETTLE_DELAY, launcher_sync_watch_sync, watch);
+		break;
+	default:
+		break;
+	}
+}
+
+static gboolean
+launcher_sync_watch_deadline_cb (gpointer user_data)
+{
+	GError *error;
+	LauncherSyncWatch *watch = (LauncherSyncWatch *)user_data;
+
+	watch->deadline_id = 0;
+
+	/* a sync that has started already reports on its own */
+	if (watch->syncing)
+		return FALSE;
+
+	launcher_sync_watch_unwatch (watch);
+
+	error = g_error_new (G_IO_ERROR, G_IO_ERROR_TIMED_OUT,
+                         "%s did not show up in %d seconds",
+                         watch->policy_path, watch->timeout);
+	if (watch->done_func)
+		watch->done_func (NULL, error, watch->user_data);
+	g_error_free (error);
+
+	return FALSE;
+}
+
+LauncherSyncWatch *
+launcher_sync_watch_new (gint                      timeout,
+                         gboolean                  keep_watching,
+                         LauncherSyncProgressFunc  progress_func,
+                         gpointer                  progress_data,
+                         LauncherSyncDoneFunc      done_func,
+                         gpointer                  user_data)
+{
+	GFile *file;
+	LauncherSyncWatch *watch;
+
+	watch = g_new0 (LauncherSyncWatch, 1);
+	watch->ref_count     = 1;
+	watch->policy_path   = launcher_sync_get_policy_path ();
+	watch->cancellable   = g_cancellable_new ();
+	watch->timeout       = timeout;
+	watch->keep_watching = keep_watching;
+	watch->progress_func = progress_func;
+	watch->progress_data = progress_data;
+	watch->done_func     = done_func;
+	watch->user_data     = user_data;
+
+	/* react as soon as the login agent writes the policy */
+	file = g_file_new_for_path (watch->policy_path);
+	watch->monitor = g_file_monitor_file (file, G_FILE_MONITOR_WATCH_MOVES, NULL, NULL);
+	if (watch->monitor)
+		g_signal_connect (watch->monitor, "changed",
+                          G_CALLBACK (launcher_sync_watch_changed_cb), watch);
+	g_object_unref (file);
+
+	if (g_file_test (watch->policy_path, G_FILE_TEST_EXISTS))
+		watch->sync_id = g_idle_add (launcher_sync_watch_sync, watch);
+
+	if (timeout > 0)
+		watch->deadline_id = g_timeout_add_seconds (timeout, launcher_sync_watch_deadline_cb, watch);
+
+	return watch;
+}
+
+void
+launcher_sync_watch_stop (LauncherSyncWatch *watch)
+{
+	g_return_if_fail (watch != NULL);
+
+	watch->done_func = NULL;
+	launcher_sync_watch_unwatch (watch);
+
+	/* progress callbacks check it as well */
+	g_cancellable_cancel (watch->cancellable);
+}
+
+gboolean
+launcher_sync_watch_is_busy (LauncherSyncWatch *watch)
+{
+	g_return_val_if_fail (watch != NULL, FALSE);
+
+	return watch->syncing;
+}
+
+void
+launcher_sync_watch_free (LauncherSyncWatch *watch)
+{
+	if (!watch)
+		return;
+
+	launcher_sync_watch_stop (watch);
+	launcher_sync_watch_unref (watch);
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __LAUNCHER_SYNC_H__
+#define __LAUNCHER_SYNC_H__
+
+#include <glib.h>
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+typedef enum
+{
+	/* reading the policy and the manifest */
+	LAUNCHER_SYNC_PHASE_POLICY,
+	/* writing the desktop files */
+	LAUNCHER_SYNC_PHASE_LAUNCHERS,
+	/* handing the launcher list to DockbarX */
+	LAUNCHER_SYNC_PHASE_PUBLISH,
+	/* fetching the favicons */
+	LAUNCHER_SYNC_PHASE_FAVICONS,
+	/* saving the manifest and the caches, cleaning up */
+	LAUNCHER_SYNC_PHASE_SAVE,
+	LAUNCHER_SYNC_N_PHASES
+} LauncherSyncPhase;
+
+typedef struct
+{
+	/* launchers found in the policy */
+	guint    n_apps;
+	/* favicons downloaded or revalidated over the network */
+	guint    n_icons_fetched;
+	/* failed downloads, unusable launchers and unwritable files */
+	guint    n_errors;
+	/* the policy had not changed since the last sync */
+	gboolean unchanged;
+	/* time spent in each phase (us) */
+	gint64   phase_time[LAUNCHER_SYNC_N_PHASES];
+} LauncherSyncResult;
+
+typedef enum
+{
+	LAUNCHER_SYNC_EVENT_PROGRESS,
+	/* the launcher list is in org.dockbarx, favicons may still follow */
+	LAUNCHER_SYNC_EVENT_PUBLISHED,
+	/* the Icon of desktop_file was replaced */
+	LAUNCHER_SYNC_EVENT_ICON_CHANGED
+} LauncherSyncEvent;
+
+typedef void (*LauncherSyncProgressFunc) (LauncherSyncEvent         event,
+                                          const gchar              *desktop_file,
+                                          const LauncherSyncResult *progress,
+                                          gpointer                  user_data);
+
+/* ~/.gooroom/.grm-user */
+gchar    *launcher_sync_get_policy_path (void);
+
+/* Publishes the launchers of the policy to DockbarX from a worker thread.
+ * progress_func is called in the thread-default main context of the
+ * caller; the sync fails with G_IO_ERROR_NOT_FOUND when there is no
+ * policy yet. */
+void      launcher_sync_async           (GCancellable              *cancellable,
+                                         LauncherSyncProgressFunc   progress_func,
+                                         gpointer                   progress_data,
+                                         GAsyncReadyCallback        callback,
+                                         gpointer                   user_data);
+gboolean  launcher_sync_finish          (GAsyncResult              *result,
+                                         LauncherSyncResult        *sync_result,
+                                         GError                   **error);
+
+/* Waits for the policy and syncs as soon as it is there. Without
+ * keep_watching that is the only sync, and when the policy has not shown
+ * up after timeout seconds (0 waits for good) done_func gets
+ * G_IO_ERROR_TIMED_OUT. With it, every later change of the policy is
+ * synced as well. result is NULL whenever error is set. */
+typedef struct _LauncherSyncWatch LauncherSyncWatch;
+
+typedef void (*LauncherSyncDoneFunc) (const LauncherSyncResult *result,
+                                      const GError             *error,
+                                      gpointer                  user_data);
+
+LauncherSyncWatch *launcher_sync_watch_new     (gint                       timeout,
+                                                gboolean                   keep_watching,
+                                                LauncherSyncProgressFunc   progress_func,
+                                                gpointer                   progress_data,
+                                                LauncherSyncDoneFunc       done_func,
+                                                gpointer                   user_data);
+/* Cancels a sync in progress; no callbacks run after this. */
+void               launcher_sync_watch_stop    (LauncherSyncWatch         *watch);
+/* A sync is still running, possibly winding down after a stop. */
+gboolean           launcher_sync_watch_is_busy (LauncherSyncWatch         *watch);
+/* Stops the watch; a running sync finishes in the background. */
+void               launcher_sync_watch_free    (LauncherSyncWatch         *watch);
+
+/* "policy", "launchers", ... */
+const gchar *launcher_sync_phase_get_name (LauncherSyncPhase         phase);
+/* Logs the result with one structured field per counter and phase. */
+void         launcher_sync_result_log     (const LauncherSyncResult *sync_result);
+
+G_END_DECLS
+
+#endif /* __LAUNCHER_SYNC_H__ */
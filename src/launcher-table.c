@@ -0,0 +1,257 @@
+/*
+ * Copyright (C) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <glib.h>
+#include <gio/gio.h>
+#include <gio/gdesktopappinfo.h>
+
+#include "launcher-table.h"
+
+/* version, generation, (id, desktop file, name, exec, icon, position, hash) */
+#define TABLE_TYPE	"(uta(sssssus))"
+#define ENTRY_TYPE	"(sssssus)"
+
+
+struct _LauncherTable
+{
+	GMappedFile *mapped;
+	GVariant    *variant;
+	GVariant    *entries;
+	guint64      generation;
+};
+
+
+static gchar *
+get_desktop_file (const gchar *launcher)
+{
+	gchar *path = NULL;
+	const gchar *sep;
+	GDesktopAppInfo *dt_info;
+
+	sep = strchr (launcher, ';');
+	if (sep)
+		return g_strdup (sep + 1);
+
+	/* a bare desktop id */
+	dt_info = g_desktop_app_info_new (launcher);
+	if (dt_info) {
+		path = g_strdup (g_desktop_app_info_get_filename (dt_info));
+		g_object_unref (dt_info);
+	}
+
+	return path ? path : g_strdup ("");
+}
+
+static GVariant *
+build_entry (const gchar *launcher, guint position)
+{
+	gsize len = 0;
+	GVariant *ret;
+	GKeyFile *keyfile;
+	gchar *desktop_file, *data = NULL, *hash = NULL;
+	gchar *name = NULL, *exec = NULL, *icon = NULL;
+
+	desktop_file = get_desktop_file (launcher);
+
+	keyfile = g_key_file_new ();
+	if (g_file_get_contents (desktop_file, &data, &len, NULL) &&
+        g_key_file_load_from_data (keyfile, data, len, G_KEY_FILE_NONE, NULL)) {
+		hash = g_compute_checksum_for_data (G_CHECKSUM_SHA256, (const guchar *)data, len);
+		name = g_key_file_get_locale_string (keyfile, G_KEY_FILE_DESKTOP_GROUP, G_KEY_FILE_DESKTOP_KEY_NAME, NULL, NULL);
+		exec = g_key_file_get_string (keyfile, G_KEY_FILE_DESKTOP_GROUP, G_KEY_FILE_DESKTOP_KEY_EXEC, NULL);
+		icon = g_key_file_get_string (keyfile, G_KEY_FILE_DESKTOP_GROUP, G_KEY_FILE_DESKTOP_KEY_ICON, NULL);
+	}
+	g_key_file_free (keyfile);
+
+	ret = g_variant_new (ENTRY_TYPE, launcher, desktop_file,
+                         name ? name : "", exec ? exec : "", icon ? icon : "",
+                         position, hash ? hash : "");
+
+	g_free (desktop_file);
+	g_free (data);
+	g_free (hash);
+	g_free (name);
+	g_free (exec);
+	g_free (icon);
+
+	return ret;
+}
+
+gchar *
+launcher_table_get_path (void)
+{
+	return g_build_filename (g_get_user_cache_dir (), PACKAGE_NAME, "launchers.table", NULL);
+}
+
+LauncherTable *
+launcher_table_load (const gchar *path)
+{
+	guint32 version;
+	GBytes *bytes;
+	GMappedFile *mapped;
+	LauncherTable *table;
+
+	g_return_val_if_fail (path != NULL, NULL);
+
+	mapped = g_mapped_file_new (path, FALSE, NULL);
+	if (!mapped)
+		return NULL;
+
+	table = g_new0 (LauncherTable, 1);
+	table->mapped = mapped;
+
+	/* untrusted: a damaged file reads as empty strings, never out of bounds */
+	bytes = g_mapped_file_get_bytes (mapped);
+	table->variant = g_variant_ref_sink (g_variant_new_from_bytes (G_VARIANT_TYPE (TABLE_TYPE), bytes, FALSE));
+	g_bytes_unref (bytes);
+
+	g_variant_get (table->variant, "(ut@a(sssssus))", &version, &table->generation, &table->entries);
+	if (version != LAUNCHER_TABLE_VERSION) {
+		launcher_table_free (table);
+		return NULL;
+	}
+
+	return table;
+}
+
+void
+launcher_table_free (LauncherTable *table)
+{
+	if (!table)
+		return;
+
+	g_clear_pointer (&table->entries, g_variant_unref);
+	g_variant_unref (table->variant);
+	g_mapped_file_unref (table->mapped);
+	g_free (table);
+}
+
+guint64
+launcher_table_get_generation (LauncherTable *table)
+{
+	g_return_val_if_fail (table != NULL, 0);
+
+	return table->generation;
+}
+
+guint
+launcher_table_get_n_entries (LauncherTable *table)
+{
+	g_return_val_if_fail (table != NULL, 0);
+
+	return g_variant_n_children (table->entries);
+}
+
+void
+launcher_table_get_entry (LauncherTable      *table,
+                          guint               position,
+                          LauncherTableEntry *entry)
+{
+	g_return_if_fail (table != NULL);
+	g_return_if_fail (entry != NULL);
+	g_return_if_fail (position < g_variant_n_children (table->entries));
+
+	g_variant_get_child (table->entries, position, "(&s&s&s&s&su&s)",
+                         &entry->id, &entry->desktop_file, &entry->name,
+                         &entry->exec, &entry->icon, &entry->position, &entry->hash);
+}
+
+gboolean
+launcher_table_matches (LauncherTable *table, const gchar * const *launchers)
+{
+	guint i, n_entries;
+
+	g_return_val_if_fail (table != NULL, FALSE);
+
+	n_entries = launcher_table_get_n_entries (table);
+	if (g_strv_length ((gchar **)launchers) != n_entries)
+		return FALSE;
+
+	for (i = 0; i < n_entries; i++) {
+		LauncherTableEntry entry;
+
+		launcher_table_get_entry (table, i, &entry);
+		if (!g_str_equal (entry.id, launchers[i]))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+gboolean
+launcher_table_update (const gchar  *path,
+                       GSList       *launchers,
+                       GError      **error)
+{
+	guint i;
+	GSList *l;
+	gchar *dir;
+	GBytes *bytes;
+	gboolean ret;
+	GVariant *entries, *variant;
+	GVariantBuilder builder;
+	LauncherTable *old_table;
+	guint64 generation = 0;
+
+	g_return_val_if_fail (path != NULL, FALSE);
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a" ENTRY_TYPE));
+	for (l = launchers, i = 0; l; l = l->next, i++)
+		g_variant_builder_add_value (&builder, build_entry (l->data, i));
+	entries = g_variant_ref_sink (g_variant_builder_end (&builder));
+
+	/* readers only look at the generation, keep it when nothing changed */
+	old_table = launcher_table_load (path);
+	if (old_table) {
+		gboolean current = g_variant_equal (old_table->entries, entries);
+
+		generation = old_table->generation;
+		launcher_table_free (old_table);
+
+		if (current) {
+			g_variant_unref (entries);
+			return TRUE;
+		}
+	}
+
+	/* even a table that was removed must not come back with an old number */
+	generation = MAX (generation + 1, (guint64)g_get_real_time ());
+
+	variant = g_variant_ref_sink (g_variant_new ("(ut@a(sssssus))", LAUNCHER_TABLE_VERSION,
+                                                 generation, entries));
+	bytes = g_variant_get_data_as_bytes (variant);
+	g_variant_unref (variant);
+	g_variant_unref (entries);
+
+	dir = g_path_get_dirname (path);
+	g_mkdir_with_parents (dir, 0700);
+	g_free (dir);
+
+	/* replaced by rename, readers keep the mapping of the old file */
+	ret = g_file_set_contents_full (path, g_bytes_get_data (bytes, NULL), g_bytes_get_size (bytes),
+                                    G_FILE_SET_CONTENTS_CONSISTENT, 0644, error);
+	g_bytes_unref (bytes);
+
+	return ret;
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __LAUNCHER_TABLE_H__
+#define __LAUNCHER_TABLE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+#define LAUNCHER_TABLE_VERSION	1
+
+/* The published launchers as one memory-mapped GVariant, so that readers
+ * get Name, Exec and Icon without parsing every desktop file. It exists
+ * only while the fallback LauncherStrip shows, which writes the first
+ * generation and removes it again; syncs update an existing table, and
+ * a new generation is written only when an entry changed. The
+ * "launchers" key of org.dockbarx stays the source of truth. */
+typedef struct _LauncherTable LauncherTable;
+
+typedef struct
+{
+	/* the launcher as DockbarX stores it, "id;/path/to/file.desktop" */
+	const gchar *id;
+	const gchar *desktop_file;
+	const gchar *name;
+	const gchar *exec;
+	const gchar *icon;
+	guint        position;
+	/* SHA-256 of the desktop file, "" when it could not be read */
+	const gchar *hash;
+} LauncherTableEntry;
+
+/* ~/.cache/gooroom-dockbarx-applet/launchers.table */
+gchar         *launcher_table_get_path       (void);
+
+/* NULL when the table is missing or was written by another version. */
+LauncherTable *launcher_table_load           (const gchar        *path);
+void           launcher_table_free           (LauncherTable      *table);
+
+guint64        launcher_table_get_generation (LauncherTable      *table);
+guint          launcher_table_get_n_entries  (LauncherTable      *table);
+/* The strings point into the mapping and live as long as the table. */
+void           launcher_table_get_entry      (LauncherTable      *table,
+                                              guint               position,
+                                              LauncherTableEntry *entry);
+/* The table lists exactly launchers, in that order. */
+gboolean       launcher_table_matches        (LauncherTable      *table,
+                                              const gchar * const *launchers);
+
+/* Writes the table for launchers unless the one at path is still current. */
+gboolean       launcher_table_update         (const gchar        *path,
+                                              GSList             *launchers,
+                                              GError            **error);
+
+G_END_DECLS
+
+#endif /* __LAUNCHER_TABLE_H__ */
@@ -40,22 +40,14 @@ _unicode_get_utf8 (const char *text, gunichar *out)
 	return (*out == (gunichar)-1) ? NULL : g_utf8_next_char (text);
 }
 
-/* Copied from evolution-data-server/libedataserver/e-util.c:
- * e_util_utf8_strstrcase() */
-const char *
-panel_g_utf8_strstrcase (const char *haystack, const char *needle)
+/* Lowercases the code points of needle into nuni, which has room for
+ * strlen (needle) of them. Returns -1 for illegal UTF-8. */
+static gint
+fold_needle (const char *needle, gunichar *nuni)
 {
-	gunichar *nuni;
 	gunichar unival;
 	gint nlen;
-	const char *o, *p;
-
-	if (haystack == NULL) return NULL;
-	if (needle == NULL) return NULL;
-	if (strlen (needle) == 0) return haystack;
-	if (strlen (haystack) == 0) return NULL;
-
-	nuni = g_alloca (sizeof (gunichar) * strlen (needle));
+	const char *p;
 
 	nlen = 0;
 	for (p = _unicode_get_utf8 (needle, &unival);
@@ -64,7 +56,28 @@ panel_g_utf8_strstrcase (const char *haystack, const char *needle)
 		nuni[nlen++] = g_unichar_tolower (unival);
 	}
 	/* NULL means there was illegal utf-8 sequence */
-	if (!p) return NULL;
+	if (!p) return -1;
+
+	return nlen;
+}
+
+static gboolean
+is_ascii (const char *text)
+{
+	for (; *text; text++)
+		if ((guchar) *text & 0x80)
+			return FALSE;
+
+	return TRUE;
+}
+
+/* Copied from evolution-data-server/libedataserver/e-util.c:
+ * e_util_utf8_strstrcase() */
+static const char *
+strstrcase_unicode (const char *haystack, const gunichar *nuni, gint nlen)
+{
+	gunichar unival;
+	const char *o, *p;
 
 	o = haystack;
 	for (p = _unicode_get_utf8 (o, &unival);
@@ -92,3 +105,60 @@ panel_g_utf8_strstrcase (const char *haystack, const char *needle)
 
 	return NULL;
 }
+
+/* For a plain ASCII needle, as long as the haystack is plain ASCII too:
+ * then g_unichar_tolower() is g_ascii_tolower() and nothing needs to be
+ * decoded. Some non-ASCII characters lowercase to ASCII ones (KELVIN SIGN
+ * to 'k'), so the first non-ASCII byte hands over to the full search. */
+static const char *
+strstrcase_ascii (const char *haystack, const char *needle, gint nlen)
+{
+	const char *h;
+	char first;
+
+	first = g_ascii_tolower (needle[0]);
+
+	for (h = haystack; *h; h++) {
+		if ((guchar) *h & 0x80) {
+			gunichar *nuni;
+			const char *start;
+
+			nuni = g_alloca (sizeof (gunichar) * nlen);
+			fold_needle (needle, nuni);
+
+			/* no match ends before h, start where one could still
+			 * reach it; everything up to h is ASCII, so this is a
+			 * character boundary */
+			start = h - MIN (h - haystack, nlen - 1);
+			return strstrcase_unicode (start, nuni, nlen);
+		}
+
+		if (g_ascii_tolower (*h) == first &&
+		    g_ascii_strncasecmp (h, needle, nlen) == 0)
+			return h;
+	}
+
+	return NULL;
+}
+
+const char *
+panel_g_utf8_strstrcase (const char *haystack, const char *needle)
+{
+	gunichar *nuni;
+	gint nlen;
+
+	if (haystack == NULL) return NULL;
+	if (needle == NULL) return NULL;
+	if (strlen (needle) == 0) return haystack;
+	if (strlen (haystack) == 0) return NULL;
+
+	if (is_ascii (needle))
+		return strstrcase_ascii (haystack, needle, strlen (needle));
+
+	nuni = g_alloca (sizeof (gunichar) * strlen (needle));
+
+	nlen = fold_needle (needle, nuni);
+	if (nlen < 0) return NULL;
+
+	return strstrcase_unicode (haystack, nuni, nlen);
+}
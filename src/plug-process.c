@@ -0,0 +1,854 @@
+/*
+ * Copyright (C) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#include <glib.h>
+#include <glib-unix.h>
+#include <gio/gio.h>
+#include <gio/gunixfdlist.h>
+#include <gio/gunixfdmessage.h>
+#include <gio/gunixinputstream.h>
+#include <gio/gunixsocketaddress.h>
+
+#include "plug-process.h"
+
+#define ZYGOTE_TIMEOUT	5 /* seconds for the zygote to fork */
+/* exit status of a forked plug without a display, see
+ * xfce4-dockbarx-plug.py */
+#define ZYGOTE_EXIT_NO_DISPLAY	75
+
+
+/* Lines on their way out; a stream takes one write at a time, the rest
+ * waits in the queue. */
+typedef struct
+{
+	GOutputStream        *stream;
+	GString              *queue;
+	gboolean              writing;
+} PlugWriter;
+
+struct _PlugProcess
+{
+	GPid                  pid;
+	gint                  pidfd;
+	/* the stdin of the plug is a socket, so that writing to a plug
+	 * that is gone fails with EPIPE instead of raising SIGPIPE */
+	GSocketConnection    *commands;
+	PlugWriter            commands_out;
+	GDataInputStream     *stdout_stream;
+	GCancellable         *cancellable;
+	gboolean              ready;
+
+	guint                 watch_id;
+	guint                 kill_id;
+
+	/* forked by the zygote, which reaps the plug and reports
+	 * "exited <status>" on this connection */
+	GSocketConnection    *zygote;
+	GDataInputStream     *zygote_stream;
+	guint                 pidfd_id;
+
+	/* while the zygote is asked to fork the plug */
+	gboolean              forking;
+	GUnixFDList          *fork_fds;
+	gchar                *fork_request;
+	guint                 fork_id;
+	gint                  pending_signal;
+
+	PlugProcessExitFunc   exit_func;
+	PlugProcessEventFunc  event_func;
+	gpointer              user_data;
+};
+
+static void plug_process_read_event (PlugProcess *process);
+static void plug_process_read_exit  (PlugProcess *process);
+
+
+static gint
+pidfd_open_pid (GPid pid)
+{
+#ifdef SYS_pidfd_open
+	return syscall (SYS_pidfd_open, pid, 0);
+#else
+	return -1;
+#endif
+}
+
+typedef struct
+{
+	PlugProcess          *process;
+	PlugWriter           *writer;
+	gchar                *data;
+} PlugWrite;
+
+static void plug_writer_flush (PlugProcess *process, PlugWriter *writer);
+
+static void
+plug_writer_done_cb (GObject      *source_object,
+                     GAsyncResult *result,
+                     gpointer      data)
+{
+	GError *error = NULL;
+	PlugWrite *write = (PlugWrite *)data;
+
+	g_output_stream_write_all_finish (G_OUTPUT_STREAM (source_object), result, NULL, &error);
+	g_free (write->data);
+
+	/* cancelled when the process is gone, do not touch it */
+	if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+		g_error_free (error);
+		g_free (write);
+		return;
+	}
+
+	write->writer->writing = FALSE;
+
+	if (error) {
+		/* the other end is gone, its exit is reported on its own */
+		if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_BROKEN_PIPE) &&
+            !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CONNECTION_CLOSED))
+			g_warning ("Could not write to DockbarX: %s", error->message);
+		g_error_free (error);
+
+		write->writer->stream = NULL;
+		g_string_truncate (write->writer->queue, 0);
+	}
+
+	plug_writer_flush (write->process, write->writer);
+	g_free (write);
+}
+
+static void
+plug_writer_flush (PlugProcess *process, PlugWriter *writer)
+{
+	gsize len;
+	PlugWrite *write;
+
+	if (writer->writing || !writer->stream || !writer->queue || writer->queue->len == 0)
+		return;
+
+	len = writer->queue->len;
+
+	write = g_new0 (PlugWrite, 1);
+	write->process = process;
+	write->writer  = writer;
+	write->data    = g_strndup (writer->queue->str, len);
+	g_string_truncate (writer->queue, 0);
+
+	writer->writing = TRUE;
+	g_output_stream_write_all_async (writer->stream, write->data, len, G_PRIORITY_DEFAULT,
+                                     process->cancellable, plug_writer_done_cb, write);
+}
+
+static gboolean
+plug_writer_send (PlugProcess *process, PlugWriter *writer, const gchar *line)
+{
+	if (!writer->stream)
+		return FALSE;
+
+	if (!writer->queue)
+		writer->queue = g_string_new (NULL);
+
+	g_string_append (writer->queue, line);
+	g_string_append_c (writer->queue, '\n');
+
+	plug_writer_flush (process, writer);
+
+	return TRUE;
+}
+
+static void
+plug_writer_clear (PlugWriter *writer)
+{
+	/* a write still in flight is cancelled along with the process */
+	writer->stream  = NULL;
+	writer->writing = FALSE;
+	if (writer->queue)
+		g_string_truncate (writer->queue, 0);
+}
+
+static gboolean
+plug_process_signal (PlugProcess *process, gint sig)
+{
+	/* there is no pid yet, it gets the harshest signal asked for */
+	if (process->forking) {
+		if (process->pending_signal != SIGKILL)
+			process->pending_signal = sig;
+		return TRUE;
+	}
+
+	if (process->pid == 0)
+		return FALSE;
+
+#ifdef SYS_pidfd_send_signal
+	if (process->pidfd != -1)
+		return (syscall (SYS_pidfd_send_signal, process->pidfd, sig, NULL, 0) == 0);
+#endif
+
+	/* The zygote reaps a forked plug before it reports the exit, so
+	 * by the time we hear of it the pid may be reused. Only the zygote
+	 * knows whether it is still the plug's; the line is short enough
+	 * to go out without blocking, or not at all. */
+	if (process->zygote) {
+		gssize sent, len;
+		gchar *command = g_strdup_printf ("signal %d\n", sig);
+
+		len = strlen (command);
+		sent = g_socket_send_with_blocking (g_socket_connection_get_socket (process->zygote),
+                                            command, len, FALSE, NULL, NULL);
+		g_free (command);
+
+		return (sent == len);
+	}
+
+	/* our child and not reaped yet, so the pid cannot belong to
+	 * anybody else; without the zygote a forked plug is out of reach */
+	if (process->watch_id > 0)
+		return (kill (process->pid, sig) == 0);
+
+	return FALSE;
+}
+
+static void
+plug_process_clear (PlugProcess *process)
+{
+	if (process->kill_id > 0) {
+		g_source_remove (process->kill_id);
+		process->kill_id = 0;
+	}
+
+	if (process->pidfd_id > 0) {
+		g_source_remove (process->pidfd_id);
+		process->pidfd_id = 0;
+	}
+
+	if (process->fork_id > 0) {
+		g_source_remove (process->fork_id);
+		process->fork_id = 0;
+	}
+	g_clear_object (&process->fork_fds);
+	g_clear_pointer (&process->fork_request, g_free);
+	process->forking = FALSE;
+
+	if (process->pidfd != -1) {
+		close (process->pidfd);
+		process->pidfd = -1;
+	}
+
+	plug_writer_clear (&process->commands_out);
+	g_clear_object (&process->commands);
+
+	/* the pending read completes with G_IO_ERROR_CANCELLED */
+	if (process->cancellable) {
+		g_cancellable_cancel (process->cancellable);
+		g_clear_object (&process->cancellable);
+	}
+	g_clear_object (&process->stdout_stream);
+	g_clear_object (&process->zygote_stream);
+	g_clear_object (&process->zygote);
+
+	process->watch_id = 0;
+	process->pid = 0;
+}
+
+static void
+plug_process_exited (PlugProcess *process, gint status)
+{
+	plug_process_clear (process);
+
+	/* last, the callback may free the process */
+	if (process->exit_func)
+		process->exit_func (process, status, process->user_data);
+}
+
+static void
+plug_process_exited_cb (GPid pid, gint status, gpointer data)
+{
+	g_spawn_close_pid (pid);
+
+	plug_process_exited ((PlugProcess *)data, status);
+}
+
+static gboolean
+plug_process_pidfd_cb (gint fd, GIOCondition condition, gpointer data)
+{
+	PlugProcess *process = (PlugProcess *)data;
+
+	process->pidfd_id = 0;
+
+	plug_process_exited (process, PLUG_PROCESS_STATUS_LOST);
+
+	return FALSE;
+}
+
+static void
+plug_process_exit_cb (GObject      *source_object,
+                      GAsyncResult *result,
+                      gpointer      data)
+{
+	gchar *line;
+	gint status;
+	GError *error = NULL;
+	PlugProcess *process;
+
+	line = g_data_input_stream_read_line_finish_utf8 (G_DATA_INPUT_STREAM (source_object),
+                                                      result, NULL, &error);
+	if (error && g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+		g_error_free (error);
+		return;
+	}
+
+	process = (PlugProcess *)data;
+
+	if (line && g_str_has_prefix (line, "exited ")) {
+		status = atoi (line + strlen ("exited "));
+		g_free (line);
+		if (WIFEXITED (status) && WEXITSTATUS (status) == ZYGOTE_EXIT_NO_DISPLAY)
+			status = PLUG_PROCESS_STATUS_NOT_FORKED;
+		plug_process_exited (process, status);
+		return;
+	}
+
+	if (error) {
+		g_warning ("Could not read from the DockbarX zygote: %s", error->message);
+		g_error_free (error);
+	}
+	g_free (line);
+
+	/* the zygote is gone and the plug with it or on its own now;
+	 * a pidfd still tells when it exits */
+	g_clear_object (&process->zygote_stream);
+	g_clear_object (&process->zygote);
+
+	if (process->pidfd != -1) {
+		process->pidfd_id = g_unix_fd_add (process->pidfd, G_IO_IN, plug_process_pidfd_cb, process);
+	} else {
+		/* whoever inherited the plug may reap it any time, so its pid
+		 * is not ours to signal; it sees its stdin close instead */
+		plug_process_exited (process, PLUG_PROCESS_STATUS_LOST);
+	}
+}
+
+static void
+plug_process_read_exit (PlugProcess *process)
+{
+	g_data_input_stream_read_line_async (process->zygote_stream, G_PRIORITY_DEFAULT,
+                                         process->cancellable,
+                                         plug_process_exit_cb, process);
+}
+
+static void
+plug_process_event_cb (GObject      *source_object,
+                       GAsyncResult *result,
+                       gpointer      data)
+{
+	gchar *line;
+	GError *error = NULL;
+	PlugProcess *process;
+
+	line = g_data_input_stream_read_line_finish_utf8 (G_DATA_INPUT_STREAM (source_object),
+                                                      result, NULL, &error);
+	if (error) {
+		/* cancelled when the process is gone, do not touch it */
+		if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+			g_warning ("Could not read from DockbarX: %s", error->message);
+		g_error_free (error);
+		return;
+	}
+
+	/* end of file, the plug is on its way out */
+	if (!line)
+		return;
+
+	process = (PlugProcess *)data;
+
+	g_strstrip (line);
+	if (g_str_equal (line, "ready"))
+		process->ready = TRUE;
+
+	plug_process_read_event (process);
+
+	/* last, the callback may free the process */
+	if (process->event_func)
+		process->event_func (process, line, process->user_data);
+
+	g_free (line);
+}
+
+static void
+plug_process_read_event (PlugProcess *process)
+{
+	g_data_input_stream_read_line_async (process->stdout_stream, G_PRIORITY_DEFAULT,
+                                         process->cancellable,
+                                         plug_process_event_cb, process);
+}
+
+static void
+orphan_exited_cb (GPid pid, gint status, gpointer data)
+{
+	g_spawn_close_pid (pid);
+}
+
+static gboolean
+plug_process_kill_cb (gpointer data)
+{
+	PlugProcess *process = (PlugProcess *)data;
+
+	process->kill_id = 0;
+
+	g_warning ("DockbarX plug %d did not exit, killing it", process->pid);
+	plug_process_signal (process, SIGKILL);
+
+	return FALSE;
+}
+
+/* Our end of the socket the plug reads its commands from, the plug's
+ * end goes to plug_fd. */
+static GSocketConnection *
+open_commands (gint *plug_fd, GError **error)
+{
+	gint fds[2];
+	GSocket *socket;
+	GSocketConnection *connection;
+
+	if (socketpair (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) == -1) {
+		gint errsv = errno;
+		g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                     "Could not create a socket pair: %s", g_strerror (errsv));
+		return NULL;
+	}
+
+	socket = g_socket_new_from_fd (fds[0], error);
+	if (!socket) {
+		close (fds[0]);
+		close (fds[1]);
+		return NULL;
+	}
+
+	connection = g_socket_connection_factory_create_connection (socket);
+	g_object_unref (socket);
+
+	*plug_fd = fds[1];
+
+	return connection;
+}
+
+PlugProcess *
+plug_process_spawn (gchar               **argv,
+                    PlugProcessExitFunc   exit_func,
+                    PlugProcessEventFunc  event_func,
+                    gpointer              user_data,
+                    GError              **error)
+{
+	GPid pid;
+	gint stdin_fd = -1;
+	gint stdout_pipe[2] = { -1, -1 };
+	GInputStream *stdout_stream;
+	GSocketConnection *commands = NULL;
+	gchar **envp = NULL;
+	PlugProcess *process = NULL;
+
+	g_return_val_if_fail (argv != NULL, NULL);
+
+	commands = open_commands (&stdin_fd, error);
+	if (!commands || !g_unix_open_pipe (stdout_pipe, FD_CLOEXEC, error))
+		goto out;
+
+	envp = g_get_environ ();
+
+	if (!g_spawn_async_with_fds (NULL, argv, envp, G_SPAWN_DO_NOT_REAP_CHILD, NULL, NULL,
+                                 &pid, stdin_fd, stdout_pipe[1], -1, error))
+		goto out;
+
+	process = g_new0 (PlugProcess, 1);
+	process->pid                  = pid;
+	process->pidfd                = pidfd_open_pid (pid);
+	process->commands             = g_steal_pointer (&commands);
+	process->commands_out.stream  = g_io_stream_get_output_stream (G_IO_STREAM (process->commands));
+	process->cancellable          = g_cancellable_new ();
+	process->exit_func            = exit_func;
+	process->event_func           = event_func;
+	process->user_data            = user_data;
+	process->watch_id             = g_child_watch_add (pid, plug_process_exited_cb, process);
+
+	stdout_stream = g_unix_input_stream_new (stdout_pipe[0], TRUE);
+	process->stdout_stream = g_data_input_stream_new (stdout_stream);
+	g_object_unref (stdout_stream);
+	stdout_pipe[0] = -1;
+
+	plug_process_read_event (process);
+
+out:
+	/* the ends of the plug are in the plug, or nowhere */
+	if (stdin_fd != -1)
+		close (stdin_fd);
+	if (stdout_pipe[0] != -1)
+		close (stdout_pipe[0]);
+	if (stdout_pipe[1] != -1)
+		close (stdout_pipe[1]);
+
+	g_clear_object (&commands);
+	g_strfreev (envp);
+
+	return process;
+}
+
+static void
+plug_process_fork_failed (PlugProcess *process, GError *error)
+{
+	g_warning ("Could not fork DockbarX from the zygote: %s", error->message);
+	g_error_free (error);
+
+	/* last, the callback may free the process */
+	plug_process_exited (process, PLUG_PROCESS_STATUS_NOT_FORKED);
+}
+
+static void
+zygote_pid_cb (GObject      *source_object,
+               GAsyncResult *result,
+               gpointer      data)
+{
+	gchar *line;
+	GPid pid = 0;
+	GError *error = NULL;
+	PlugProcess *process;
+
+	line = g_data_input_stream_read_line_finish_utf8 (G_DATA_INPUT_STREAM (source_object),
+                                                      result, NULL, &error);
+	if (error && g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+		g_error_free (error);
+		return;
+	}
+
+	process = (PlugProcess *)data;
+
+	/* "pid <pid>" */
+	if (line && g_str_has_prefix (line, "pid "))
+		pid = atoi (line + strlen ("pid "));
+	if (pid <= 0 && !error)
+		error = g_error_new (G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                             "Unexpected reply from the zygote: %s", line ? line : "(none)");
+	g_free (line);
+
+	if (error) {
+		plug_process_fork_failed (process, error);
+		return;
+	}
+
+	process->forking = FALSE;
+	process->pid     = pid;
+	process->pidfd   = pidfd_open_pid (pid);
+
+	/* from now on it only reports the exit, whenever that is */
+	g_socket_set_timeout (g_socket_connection_get_socket (process->zygote), 0);
+	plug_process_read_exit (process);
+
+	if (process->pending_signal != 0)
+		plug_process_signal (process, process->pending_signal);
+}
+
+static gboolean
+zygote_writable_cb (GSocket *socket, GIOCondition condition, gpointer data)
+{
+	gssize sent;
+	GOutputVector vector;
+	GSocketControlMessage *message;
+	GError *error = NULL;
+	PlugProcess *process = (PlugProcess *)data;
+
+	process->fork_id = 0;
+
+	/* writable, so the short request goes out at once; after
+	 * ZYGOTE_TIMEOUT this fails with G_IO_ERROR_TIMED_OUT instead */
+	message = g_unix_fd_message_new_with_fd_list (process->fork_fds);
+	vector.buffer = process->fork_request;
+	vector.size = strlen (process->fork_request);
+
+	sent = g_socket_send_message (socket, NULL, &vector, 1, &message, 1,
+                                  G_SOCKET_MSG_NONE, NULL, &error);
+	g_object_unref (message);
+
+	if (sent >= 0 && (gsize)sent != vector.size)
+		error = g_error_new_literal (G_IO_ERROR, G_IO_ERROR_FAILED,
+                                     "Short write to the zygote");
+
+	/* the ends of the plug are in the zygote, or nowhere */
+	g_clear_object (&process->fork_fds);
+	g_clear_pointer (&process->fork_request, g_free);
+
+	if (error) {
+		plug_process_fork_failed (process, error);
+		return G_SOURCE_REMOVE;
+	}
+
+	g_data_input_stream_read_line_async (process->zygote_stream, G_PRIORITY_DEFAULT,
+                                         process->cancellable,
+                                         zygote_pid_cb, process);
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+zygote_connected_cb (GObject      *source_object,
+                     GAsyncResult *result,
+                     gpointer      data)
+{
+	GSource *source;
+	GError *error = NULL;
+	GSocketConnection *connection;
+	PlugProcess *process;
+
+	connection = g_socket_client_connect_finish (G_SOCKET_CLIENT (source_object), result, &error);
+	if (error && g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+		g_error_free (error);
+		return;
+	}
+
+	process = (PlugProcess *)data;
+
+	if (!connection) {
+		plug_process_fork_failed (process, error);
+		return;
+	}
+
+	process->zygote        = connection;
+	process->zygote_stream = g_data_input_stream_new (g_io_stream_get_input_stream (G_IO_STREAM (connection)));
+
+	/* the file descriptors only go along with a message on the socket
+	 * itself, the stream has no way to send them */
+	source = g_socket_create_source (g_socket_connection_get_socket (connection), G_IO_OUT, NULL);
+	g_source_set_callback (source, (GSourceFunc)zygote_writable_cb, process, NULL);
+	process->fork_id = g_source_attach (source, NULL);
+	g_source_unref (source);
+}
+
+PlugProcess *
+plug_process_spawn_forked (const gchar          *zygote_path,
+                           gchar               **args,
+                           PlugProcessExitFunc   exit_func,
+                           PlugProcessEventFunc  event_func,
+                           gpointer              user_data,
+                           GError              **error)
+{
+	gint stdin_fd = -1;
+	gint stdout_pipe[2] = { -1, -1 };
+	gchar *joined;
+	GUnixFDList *fd_list = NULL;
+	GSocketClient *client;
+	GSocketAddress *address;
+	GInputStream *stdout_stream;
+	GSocketConnection *commands = NULL;
+	PlugProcess *process = NULL;
+
+	g_return_val_if_fail (zygote_path != NULL, NULL);
+	g_return_val_if_fail (args != NULL, NULL);
+
+	commands = open_commands (&stdin_fd, error);
+	if (!commands || !g_unix_open_pipe (stdout_pipe, FD_CLOEXEC, error))
+		goto out;
+
+	/* the plug gets its ends of the socket and the pipe, and our stderr */
+	fd_list = g_unix_fd_list_new ();
+	if (g_unix_fd_list_append (fd_list, stdin_fd, error) == -1 ||
+        g_unix_fd_list_append (fd_list, stdout_pipe[1], error) == -1 ||
+        g_unix_fd_list_append (fd_list, STDERR_FILENO, error) == -1)
+		goto out;
+
+	joined = g_strjoinv (" ", args);
+
+	process = g_new0 (PlugProcess, 1);
+	process->pidfd                = -1;
+	process->forking              = TRUE;
+	process->fork_fds             = g_steal_pointer (&fd_list);
+	process->fork_request         = g_strdup_printf ("spawn %s\n", joined);
+	process->commands             = g_steal_pointer (&commands);
+	process->commands_out.stream  = g_io_stream_get_output_stream (G_IO_STREAM (process->commands));
+	process->cancellable          = g_cancellable_new ();
+	process->exit_func            = exit_func;
+	process->event_func           = event_func;
+	process->user_data            = user_data;
+
+	g_free (joined);
+
+	stdout_stream = g_unix_input_stream_new (stdout_pipe[0], TRUE);
+	process->stdout_stream = g_data_input_stream_new (stdout_stream);
+	g_object_unref (stdout_stream);
+	stdout_pipe[0] = -1;
+
+	plug_process_read_event (process);
+
+	/* a local fork, not worth waiting for any longer; the timeout
+	 * stays on the socket for the request and the reply */
+	client = g_socket_client_new ();
+	g_socket_client_set_timeout (client, ZYGOTE_TIMEOUT);
+
+	address = g_unix_socket_address_new (zygote_path);
+	g_socket_client_connect_async (client, G_SOCKET_CONNECTABLE (address), process->cancellable,
+                                   zygote_connected_cb, process);
+	g_object_unref (address);
+	g_object_unref (client);
+
+out:
+	/* the fd list holds copies of the ends of the plug */
+	if (stdin_fd != -1)
+		close (stdin_fd);
+	if (stdout_pipe[0] != -1)
+		close (stdout_pipe[0]);
+	if (stdout_pipe[1] != -1)
+		close (stdout_pipe[1]);
+
+	g_clear_object (&fd_list);
+	g_clear_object (&commands);
+
+	return process;
+}
+
+void
+plug_process_free (PlugProcess *process)
+{
+	GPid pid;
+
+	if (!process)
+		return;
+
+	pid = process->pid;
+
+	if (pid != 0) {
+		plug_process_signal (process, SIGTERM);
+
+		/* the zygote reaps the plugs it forked */
+		if (process->watch_id > 0) {
+			g_source_remove (process->watch_id);
+			g_child_watch_add (pid, orphan_exited_cb, NULL);
+		}
+	}
+
+	/* still forking: a plug the zygote forks after all finds its
+	 * stdin closed */
+	plug_process_clear (process);
+	if (process->commands_out.queue)
+		g_string_free (process->commands_out.queue, TRUE);
+	g_free (process);
+}
+
+gboolean
+plug_process_is_running (PlugProcess *process)
+{
+	return (process && (process->pid != 0 || process->forking));
+}
+
+gboolean
+plug_process_is_ready (PlugProcess *process)
+{
+	return (process && process->ready);
+}
+
+GPid
+plug_process_get_pid (PlugProcess *process)
+{
+	g_return_val_if_fail (process != NULL, 0);
+
+	return process->pid;
+}
+
+gboolean
+plug_process_get_usage (PlugProcess *process, guint64 *rss, guint64 *cpu_time)
+{
+	gchar *path, *contents = NULL;
+	gchar **fields = NULL;
+	const gchar *p;
+	guint64 pages = 0;
+	gboolean ret = FALSE;
+
+	g_return_val_if_fail (process != NULL, FALSE);
+
+	if (process->pid == 0)
+		return FALSE;
+
+	/* size resident shared ..., in pages */
+	path = g_strdup_printf ("/proc/%d/statm", process->pid);
+	if (g_file_get_contents (path, &contents, NULL, NULL))
+		ret = (sscanf (contents, "%*u %" G_GUINT64_FORMAT, &pages) == 1);
+	g_free (contents);
+	g_free (path);
+
+	if (!ret)
+		return FALSE;
+
+	/* pid (comm) state ..., comm may contain anything but ends at
+	 * the last parenthesis; utime and stime are fields 14 and 15 */
+	path = g_strdup_printf ("/proc/%d/stat", process->pid);
+	ret = g_file_get_contents (path, &contents, NULL, NULL);
+	g_free (path);
+
+	p = ret ? strrchr (contents, ')') : NULL;
+	if (p)
+		fields = g_strsplit (p + 2, " ", 14);
+
+	ret = (fields && g_strv_length (fields) >= 13);
+	if (ret) {
+		guint64 ticks = g_ascii_strtoull (fields[11], NULL, 10) +
+                        g_ascii_strtoull (fields[12], NULL, 10);
+
+		if (rss)
+			*rss = pages * sysconf (_SC_PAGESIZE);
+		if (cpu_time)
+			*cpu_time = ticks * G_USEC_PER_SEC / sysconf (_SC_CLK_TCK);
+	}
+
+	g_strfreev (fields);
+	g_free (contents);
+
+	return ret;
+}
+
+gboolean
+plug_process_send (PlugProcess *process, const gchar *command)
+{
+	g_return_val_if_fail (process != NULL, FALSE);
+	g_return_val_if_fail (command != NULL, FALSE);
+
+	return plug_writer_send (process, &process->commands_out, command);
+}
+
+void
+plug_process_stop (PlugProcess *process, guint timeout_ms)
+{
+	g_return_if_fail (process != NULL);
+
+	if (!plug_process_is_running (process) || process->kill_id > 0)
+		return;
+
+	if (!plug_process_signal (process, SIGTERM))
+		g_warning ("Could not stop DockbarX plug %d: %s", process->pid, g_strerror (errno));
+
+	process->kill_id = g_timeout_add (timeout_ms, plug_process_kill_cb, process);
+}
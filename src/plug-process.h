@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __PLUG_PROCESS_H__
+#define __PLUG_PROCESS_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* A DockbarX plug started by the applet. The process is signalled through
+ * a pidfd where the kernel has them, otherwise by pid before our child
+ * watch reaps it, or by the zygote that forked and reaps it, so only the
+ * process we started is ever touched. Commands go to the plug one line at
+ * a time on its stdin, events like "ready" come back on its stdout. */
+typedef struct _PlugProcess PlugProcess;
+
+/* wait_status of a forked plug whose zygote went away first */
+#define PLUG_PROCESS_STATUS_LOST	(-2)
+/* wait_status of a plug the zygote could not fork, or that found no
+ * display after the fork; started directly it may still work */
+#define PLUG_PROCESS_STATUS_NOT_FORKED	(-3)
+
+typedef void (*PlugProcessExitFunc)  (PlugProcess *process,
+                                      gint         wait_status,
+                                      gpointer     user_data);
+typedef void (*PlugProcessEventFunc) (PlugProcess *process,
+                                      const gchar *event,
+                                      gpointer     user_data);
+
+PlugProcess *plug_process_spawn        (gchar               **argv,
+                                        PlugProcessExitFunc   exit_func,
+                                        PlugProcessEventFunc  event_func,
+                                        gpointer              user_data,
+                                        GError              **error);
+
+/* Has the zygote listening on zygote_path fork a plug with args, which
+ * then behaves like a spawned one. The request goes out without blocking,
+ * so the process has no pid yet when this returns; signals sent in the
+ * meantime are delivered once the zygote reports it, and a failed fork
+ * ends in PLUG_PROCESS_STATUS_NOT_FORKED. */
+PlugProcess *plug_process_spawn_forked (const gchar          *zygote_path,
+                                        gchar               **args,
+                                        PlugProcessExitFunc   exit_func,
+                                        PlugProcessEventFunc  event_func,
+                                        gpointer              user_data,
+                                        GError              **error);
+
+/* A process that is still running is sent SIGTERM and reaped later. */
+void         plug_process_free         (PlugProcess          *process);
+
+gboolean     plug_process_is_running   (PlugProcess          *process);
+/* The plug has sent "ready": DockbarX is loaded. */
+gboolean     plug_process_is_ready     (PlugProcess          *process);
+GPid         plug_process_get_pid      (PlugProcess          *process);
+/* Resident set size (bytes) and user plus system CPU time (us) from
+ * /proc. */
+gboolean     plug_process_get_usage    (PlugProcess          *process,
+                                        guint64              *rss,
+                                        guint64              *cpu_time);
+
+/* Queues one line for the stdin of the plug, which is written without
+ * blocking. FALSE once the plug can no longer be written to. */
+gboolean     plug_process_send         (PlugProcess          *process,
+                                        const gchar          *command);
+
+/* Sends SIGTERM, and SIGKILL when the process is still around after
+ * timeout_ms. The exit func runs once it has been reaped. */
+void         plug_process_stop         (PlugProcess          *process,
+                                        guint                 timeout_ms);
+
+G_END_DECLS
+
+#endif /* __PLUG_PROCESS_H__ */
@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "program-cache.h"
+
+#define DEFAULT_PATH	"/usr/local/bin:/usr/bin:/bin"
+
+
+struct _ProgramCache
+{
+	gchar      **dirs;
+
+	/* file name -> first $PATH directory listing it */
+	GHashTable  *entries;
+	/* program -> absolute path, or "" when it cannot be run */
+	GHashTable  *resolved;
+};
+
+
+static gboolean
+is_executable (const gchar *path)
+{
+	return (g_file_test (path, G_FILE_TEST_IS_EXECUTABLE) &&
+            !g_file_test (path, G_FILE_TEST_IS_DIR));
+}
+
+static gchar *
+resolve_program (ProgramCache *cache, const gchar *program)
+{
+	const gchar *dir;
+	gchar *path;
+
+	if (strchr (program, '/'))
+		return is_executable (program) ? g_strdup (program) : NULL;
+
+	dir = g_hash_table_lookup (cache->entries, program);
+	if (!dir)
+		return NULL;
+
+	path = g_build_filename (dir, program, NULL);
+	if (is_executable (path))
+		return path;
+	g_free (path);
+
+	/* shadowed by something that is not executable, which is rare
+	 * enough to leave to the full search */
+	return g_find_program_in_path (program);
+}
+
+ProgramCache *
+program_cache_new (void)
+{
+	guint i;
+	const gchar *path;
+	ProgramCache *cache;
+
+	cache = g_new0 (ProgramCache, 1);
+	cache->entries  = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	cache->resolved = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+	path = g_getenv ("PATH");
+	if (!path || *path == '\0')
+		path = DEFAULT_PATH;
+
+	cache->dirs = g_strsplit (path, G_SEARCHPATH_SEPARATOR_S, -1);
+
+	for (i = 0; cache->dirs[i] != NULL; i++) {
+		GDir *dir;
+		const gchar *name;
+
+		if (*cache->dirs[i] == '\0')
+			continue;
+
+		dir = g_dir_open (cache->dirs[i], 0, NULL);
+		if (!dir)
+			continue;
+
+		/* earlier directories win, like in a $PATH search */
+		while ((name = g_dir_read_name (dir)) != NULL) {
+			if (!g_hash_table_contains (cache->entries, name))
+				g_hash_table_insert (cache->entries, g_strdup (name), cache->dirs[i]);
+		}
+
+		g_dir_close (dir);
+	}
+
+	return cache;
+}
+
+void
+program_cache_free (ProgramCache *cache)
+{
+	if (!cache)
+		return;
+
+	g_hash_table_destroy (cache->entries);
+	g_hash_table_destroy (cache->resolved);
+	g_strfreev (cache->dirs);
+	g_free (cache);
+}
+
+const gchar *
+program_cache_lookup (ProgramCache *cache, const gchar *program)
+{
+	gchar *path;
+
+	g_return_val_if_fail (cache != NULL, NULL);
+
+	if (!program || *program == '\0')
+		return NULL;
+
+	path = g_hash_table_lookup (cache->resolved, program);
+	if (!path) {
+		path = resolve_program (cache, program);
+		if (!path)
+			path = g_strdup ("");
+		g_hash_table_insert (cache->resolved, g_strdup (program), path);
+	}
+
+	return (*path != '\0') ? path : NULL;
+}
+
+gboolean
+program_cache_exec_exists (ProgramCache *cache, const gchar *exec)
+{
+	gint argc = 0;
+	gchar **argv = NULL;
+	gboolean ret = FALSE;
+
+	g_return_val_if_fail (cache != NULL, FALSE);
+
+	if (!exec)
+		return FALSE;
+
+	if (g_shell_parse_argv (exec, &argc, &argv, NULL) && argc > 0)
+		ret = (program_cache_lookup (cache, argv[0]) != NULL);
+	else
+		ret = (program_cache_lookup (cache, exec) != NULL);
+
+	g_strfreev (argv);
+
+	return ret;
+}
@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __PROGRAM_CACHE_H__
+#define __PROGRAM_CACHE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* A replacement for repeated g_find_program_in_path() calls: every $PATH
+ * directory is listed once and results are remembered for the run. */
+typedef struct _ProgramCache ProgramCache;
+
+ProgramCache *program_cache_new         (void);
+void          program_cache_free        (ProgramCache *cache);
+
+const gchar  *program_cache_lookup      (ProgramCache *cache,
+                                         const gchar  *program);
+gboolean      program_cache_exec_exists (ProgramCache *cache,
+                                         const gchar  *exec);
+
+G_END_DECLS
+
+#endif /* __PROGRAM_CACHE_H__ */
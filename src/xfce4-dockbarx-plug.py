@@ -25,6 +25,21 @@ import io
 import traceback
 import os
 
+# A zygote imports everything once and forks the plugs from there. It
+# must not hold a connection to the display or the session bus, the
+# plugs open their own after the fork. Without XDG_RUNTIME_DIR neither
+# the bus ($XDG_RUNTIME_DIR/bus) nor Wayland can be found by default.
+ZYGOTE_HIDDEN_ENV = ("DISPLAY", "WAYLAND_DISPLAY", "DBUS_SESSION_BUS_ADDRESS",
+                     "XDG_RUNTIME_DIR")
+# A forked plug exits with this when GTK finds no display after the fork,
+# the applet then starts its plugs directly (see plug-process.c).
+EXIT_NO_DISPLAY = 75
+hidden_env = {}
+if "--zygote" in sys.argv:
+    for name in ZYGOTE_HIDDEN_ENV:
+        if name in os.environ:
+            hidden_env[name] = os.environ.pop(name)
+
 import gi
 gi.require_version("Gtk", "3.0")
 gi.require_version("Gio", "2.0")
@@ -32,12 +47,20 @@ gi.require_version("Gdk", "3.0")
 from gi.repository import Gtk
 from gi.repository import Gio
 from gi.repository import Gdk
+from gi.repository import GLib
 import cairo
 
 from optparse import OptionParser
 
-GSETTINGS_CLIENT = Gio.Settings.new("org.dockbarx")
-GSETTINGS_DT_IFACE_CLIENT = Gio.Settings.new("org.gnome.desktop.interface")
+# Created by run_plug(), a zygote must not talk to dconf.
+GSETTINGS_CLIENT = None
+GSETTINGS_DT_IFACE_CLIENT = None
+ICON_THEME_DELAY = 300 # ms without icon-theme changes
+ICON_LOOKUP_SIZE = 48
+# Favicons pre-rasterized by the launcher sync, with the pixels in an
+# icon-theme.cache that GTK maps instead of decoding every PNG.
+ICON_ATLAS_DIR = os.path.join(GLib.get_user_cache_dir(),
+                              "gooroom-dockbarx-applet", "icon-atlas")
 #BACKGROUND_PATH = "/usr/share/backgrounds/gooroom/panel-bg.png"
 
 # A very minimal plug application that loads DockbarX
@@ -47,22 +70,40 @@ class DockBarXFCEPlug(Gtk.Plug):
     __gsignals__ = {"draw": "override"}
 
     def __init__ (self):
+        # stdout carries events for the applet, anything DockbarX prints
+        # goes to stderr instead.
+        self.events = os.fdopen(os.dup(sys.stdout.fileno()), "w")
+        os.dup2(sys.stderr.fileno(), sys.stdout.fileno())
+
         import dockbarx.dockbar as db
 
         parser = OptionParser(usage="", add_help_option=False)
         parser.add_option("-s", "--socket", default = 0, help = "Socket ID")
+        parser.add_option("--standby", action = "store_true", default = False,
+                          help = "Load DockbarX and wait for an embed command")
         (options, args) = parser.parse_args()
 
         # Sanity checks.
-        if options.socket == 0:
+        if options.socket == 0 and not options.standby:
             sys.exit("This program needs to be run by the XFCE DBX plugin.")
 
         Gtk.Plug.__init__(self)
-        self.construct(int(options.socket))
+        self.embedded = False
+        self.drawn = False
+        if not options.standby:
+            self.construct(int(options.socket))
+            self.embedded = True
         self.connect("destroy", self.destroy)
         self.set_app_paintable(True)
         gtk_screen = Gdk.Screen.get_default()
-        colormap = gtk_screen.get_rgba_visual()
+        # Without a compositor the alpha channel only costs, so
+        # GOOROOM_DOCKBARX_OPAQUE=1 keeps to the plain visual.
+        if os.environ.get("GOOROOM_DOCKBARX_OPAQUE") == "1":
+            colormap = gtk_screen.get_system_visual()
+            self.background = cairo.SolidPattern(0.0, 0.0, 0.0)
+        else:
+            colormap = gtk_screen.get_rgba_visual()
+            self.background = cairo.SolidPattern(0.0, 0.0, 0.0, 0.7)
         # don't use this function after pygobject
         #if colormap is None: colormap = gtk_screen.get_rgb_colormap()
         self.set_visual(colormap)
@@ -76,6 +117,8 @@ class DockBarXFCEPlug(Gtk.Plug):
 #            self.pattern = cairo.SurfacePattern(surface)
 #            self.pattern.set_extend(cairo.EXTEND_REPEAT)
 
+        Gtk.IconTheme.get_default().prepend_search_path(ICON_ATLAS_DIR)
+
         self.dockbar = db.DockBar(self)
         self.dockbar.set_expose_on_clear(True)
         self.dockbar.load()
@@ -84,8 +127,102 @@ class DockBarXFCEPlug(Gtk.Plug):
         Gtk.Alignment.set_padding(self.align, 2, 0, 0, 0)
         self.align.add(self.dockbar.get_container())
         self.add(self.align)
-        self.dockbar.set_max_size(self.get_size())
-        self.show_all()
+        if self.embedded:
+            self.dockbar.set_max_size(self.get_size())
+            self.show_all()
+
+        # Icon theme changes come in bursts, they are handled once
+        # the key has been quiet for a moment.
+        self.icon_theme_id = 0
+        self.icon_lookups = self.get_icon_lookups()
+
+        # The applet sends one command per line on stdin.
+        self.reload_id = 0
+        self.commands = Gio.DataInputStream.new(
+                            Gio.UnixInputStream.new(sys.stdin.fileno(), False))
+        self.read_command()
+
+        # DockbarX is loaded, the applet may hand us requests now.
+        self.send_event("ready")
+
+    def send_event(self, event):
+        try:
+            self.events.write(event + "\n")
+            self.events.flush()
+        except (IOError, OSError):
+            pass
+
+    def read_command(self):
+        self.commands.read_line_async(GLib.PRIORITY_DEFAULT, None,
+                                      self.on_command)
+
+    def on_command(self, stream, result):
+        try:
+            line, length = stream.read_line_finish_utf8(result)
+        except GLib.Error:
+            return
+        if line is None:
+            # The applet closed the pipe. A standby plug has nothing
+            # left to wait for.
+            if not self.embedded:
+                Gtk.main_quit()
+            return
+        command, _, arg = line.strip().partition(" ")
+        if command == "embed" and not self.embedded:
+            # Everything is loaded already, only show up in the socket.
+            self.construct(int(arg))
+            self.embedded = True
+            self.dockbar.set_max_size(self.get_size())
+            self.show_all()
+        elif command == "reload-launchers":
+            # The launcher sync has finished, show its result without
+            # waiting for the next restart.
+            self.dockbar.reload()
+        elif command == "update-icon":
+            # A favicon has arrived for the launcher in this desktop file.
+            self.update_launcher_icon(arg)
+        elif command == "relayout":
+            # The monitors have changed, the applet sends "<max size> <h|v>".
+            self.relayout(arg)
+        self.read_command()
+
+    def relayout(self, arg):
+        size, _, orient = arg.partition(" ")
+        try:
+            max_size = int(size)
+        except ValueError:
+            max_size = self.get_size()
+        if max_size < 1: max_size = 32767
+        if orient in ("h", "v"):
+            try:
+                self.dockbar.set_orient(orient)
+            except AttributeError:
+                pass
+        self.dockbar.set_max_size(max_size)
+        self.queue_resize()
+
+    def update_launcher_icon(self, path):
+        Gtk.IconTheme.get_default().rescan_if_needed()
+        try:
+            for group in self.dockbar.groups:
+                entry = group.desktop_entry
+                if entry is None or entry.getFileName() != path:
+                    continue
+                entry.parse(path)
+                group.button.icon_factory.reset_surfaces()
+                group.button.update_state(force_update=True)
+                return
+        except AttributeError:
+            pass
+        # Not a launcher this DockbarX knows how to refresh by itself,
+        # fall back to one reload for a burst of updates.
+        if self.reload_id == 0:
+            self.reload_id = GLib.timeout_add(500, self.on_reload_timeout)
+
+    def on_reload_timeout(self):
+        self.reload_id = 0
+        self.dockbar.reload()
+        return False
 
     def on_max_size_changed(self, settings, keyname):
         if keyname == 'max-size':
@@ -93,7 +230,53 @@ class DockBarXFCEPlug(Gtk.Plug):
 
     def on_icon_theme_changed(self, settings, keyname):
         if keyname == 'icon-theme':
+            if self.icon_theme_id:
+                GLib.source_remove(self.icon_theme_id)
+            self.icon_theme_id = GLib.timeout_add(ICON_THEME_DELAY,
+                                                  self.on_icon_theme_timeout)
+
+    def get_icon_lookups(self):
+        # desktop file -> file the icon theme resolves its icon to
+        theme = Gtk.IconTheme.get_default()
+        lookups = {}
+        try:
+            for group in self.dockbar.groups:
+                entry = group.desktop_entry
+                if entry is None:
+                    continue
+                icon = entry.getIcon()
+                info = None
+                if icon and not os.path.isabs(icon):
+                    info = theme.lookup_icon(icon, ICON_LOOKUP_SIZE, 0)
+                lookups[entry.getFileName()] = \
+                    info.get_filename() if info else icon
+        except AttributeError:
+            pass
+        return lookups
+
+    def on_icon_theme_timeout(self):
+        self.icon_theme_id = 0
+        # Do not wait for the settings daemon to tell GTK.
+        theme_name = GSETTINGS_DT_IFACE_CLIENT.get_string("icon-theme")
+        Gtk.Settings.get_default().set_property("gtk-icon-theme-name",
+                                                theme_name)
+        Gtk.IconTheme.get_default().rescan_if_needed()
+        old_lookups = self.icon_lookups
+        self.icon_lookups = self.get_icon_lookups()
+        try:
+            for group in self.dockbar.groups:
+                entry = group.desktop_entry
+                # Windows without a launcher have no lookup to compare.
+                if entry is not None:
+                    path = entry.getFileName()
+                    if old_lookups.get(path) == self.icon_lookups.get(path):
+                        continue
+                group.button.icon_factory.reset_surfaces()
+                group.button.update_state(force_update=True)
+        except AttributeError:
+            # A DockbarX without these internals gets the full reload.
             self.dockbar.reload()
+        return False
 
     def get_size (self):
         max_size = GSETTINGS_CLIENT.get_int("max-size")
@@ -106,24 +289,256 @@ class DockBarXFCEPlug(Gtk.Plug):
         self.show_all()
 
     # Imitates gnome-panel's expose event.
-    def do_draw(self, event):
-        # don't use this function after 3.22
-        ctx = self.get_window().cairo_create()
-        ctx.set_antialias(cairo.ANTIALIAS_NONE)
+    def do_draw(self, ctx):
+        # GTK clips ctx to the damaged area, so a hover effect only
+        # repaints the background behind the button it changes.
+        ctx.save()
         ctx.set_operator(cairo.OPERATOR_SOURCE)
-        rect = self.get_allocation()
-        ctx.rectangle(rect.x, rect.y,
-                      rect.width, rect.height)
-        ctx.clip()
-        ctx.set_source_rgba(0.0,0.0,0.0,0.7)
+        ctx.set_source(self.background)
         ctx.paint()
+        ctx.restore()
         if self.get_child():
-            self.propagate_draw(self.get_child(), event)
+            self.propagate_draw(self.get_child(), ctx)
+        # The applet times the login up to the first visible frame.
+        if self.embedded and not self.drawn:
+            self.drawn = True
+            self.send_event("drawn")
 
     def destroy (self, widget, data=None):
         Gtk.main_quit()
 
 
-if __name__ == '__main__':
+def run_plug():
+    global GSETTINGS_CLIENT, GSETTINGS_DT_IFACE_CLIENT
+    GSETTINGS_CLIENT = Gio.Settings.new("org.dockbarx")
+    GSETTINGS_DT_IFACE_CLIENT = Gio.Settings.new("org.gnome.desktop.interface")
     dbx = DockBarXFCEPlug()
     Gtk.main()
+
+
+def preload():
+    try:
+        import dockbarx.dockbar
+    except Exception:
+        # It wants the display or the bus already, so every plug
+        # imports it for itself.
+        for name in list(sys.modules):
+            if name == "dockbarx" or name.startswith("dockbarx."):
+                del sys.modules[name]
+
+
+def connected_sockets():
+    # The peers of the connected sockets beyond stdin, stdout and stderr,
+    # which may be a journal stream.
+    import socket
+    peers = []
+    for name in os.listdir("/proc/self/fd"):
+        fd = int(name)
+        if fd <= 2:
+            continue
+        try:
+            if not os.readlink("/proc/self/fd/%d" % fd).startswith("socket:"):
+                continue
+            sock = socket.socket(fileno=os.dup(fd))
+        except OSError:
+            continue
+        try:
+            peers.append(sock.getpeername() or "fd %d" % fd)
+        except OSError:
+            # listening or not connected
+            pass
+        finally:
+            sock.close()
+    return peers
+
+
+def move_to_own_scope(memory_max):
+    # The zygote runs in the scope systemd-run made for it, and every plug
+    # forked from there would share its one MemoryMax. A plug moves itself
+    # to a scope of its own with the same limit instead, which it can do
+    # without racing its own exit. Under prlimit the limit is per process
+    # already.
+    runtime_dir = os.environ.get("XDG_RUNTIME_DIR", "")
+    if not os.path.exists(os.path.join(runtime_dir, "systemd", "private")):
+        return
+    pid = os.getpid()
+    properties = [("PIDs", GLib.Variant("au", [pid])),
+                  ("MemoryMax", GLib.Variant("t", memory_max * 1024 * 1024)),
+                  ("CollectMode", GLib.Variant("s", "inactive-or-failed"))]
+    try:
+        bus = Gio.bus_get_sync(Gio.BusType.SESSION, None)
+        bus.call_sync("org.freedesktop.systemd1", "/org/freedesktop/systemd1",
+                      "org.freedesktop.systemd1.Manager", "StartTransientUnit",
+                      GLib.Variant("(ssa(sv)a(sa(sv)))",
+                                   ("gooroom-dockbarx-plug-%d.scope" % pid, "fail",
+                                    properties, [])),
+                      GLib.VariantType("(o)"), Gio.DBusCallFlags.NONE, -1, None)
+    except GLib.Error as e:
+        sys.stderr.write("DockbarX: no memory limit of its own, sharing the zygote's: %s\n"
+                         % e.message)
+
+
+def run_forked_plug(args, fds, memory_max):
+    status = 0
+    try:
+        for i, fd in enumerate(fds):
+            os.dup2(fd, i)
+            os.close(fd)
+        os.environ.update(hidden_env)
+        sys.argv = [sys.argv[0]] + args
+        if memory_max > 0:
+            move_to_own_scope(memory_max)
+        # GTK gave up on the display when the zygote imported it.
+        initialized, sys.argv = Gtk.init_check(sys.argv)
+        if not initialized or Gdk.Display.get_default() is None:
+            sys.stderr.write("DockbarX: no display after the fork\n")
+            status = EXIT_NO_DISPLAY
+            return
+        run_plug()
+    except SystemExit as e:
+        if isinstance(e.code, str):
+            sys.stderr.write(e.code + "\n")
+            status = 1
+        elif e.code:
+            status = e.code
+    except BaseException:
+        traceback.print_exc()
+        status = 1
+    finally:
+        sys.stderr.flush()
+        os._exit(status)
+
+
+def run_zygote(path, memory_max):
+    import selectors
+    import signal
+    import socket
+
+    preload()
+
+    # Every plug forked from here would share a bus or display
+    # connection an import opened, and none of them could use it.
+    peers = connected_sockets()
+    if peers:
+        sys.exit("DockbarX zygote: connected to %s after preloading, not forking plugs"
+                 % ", ".join(str(peer) for peer in peers))
+
+    try:
+        os.unlink(path)
+    except FileNotFoundError:
+        pass
+    server = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    server.bind(path)
+    os.chmod(path, 0o600)
+    server.listen(4)
+
+    wakeup_r, wakeup_w = socket.socketpair()
+    wakeup_r.setblocking(False)
+    wakeup_w.setblocking(False)
+    signal.set_wakeup_fd(wakeup_w.fileno())
+    signal.signal(signal.SIGCHLD, lambda signum, frame: None)
+
+    selector = selectors.DefaultSelector()
+    selector.register(server, selectors.EVENT_READ)
+    selector.register(wakeup_r, selectors.EVENT_READ)
+    selector.register(sys.stdin, selectors.EVENT_READ)
+
+    # pid -> connection waiting for "exited <status>"
+    children = {}
+    # connection still read from -> the start of a line from the applet
+    partial = {}
+
+    sys.stdout.write("ready\n")
+    sys.stdout.flush()
+
+    while True:
+        for key, mask in selector.select():
+            if key.fileobj is server:
+                conn, _ = server.accept()
+                try:
+                    # "spawn <args>" with the stdin, stdout and stderr
+                    # of the plug attached
+                    data, fds, flags, addr = socket.recv_fds(conn, 4096, 3)
+                except OSError:
+                    conn.close()
+                    continue
+                command, _, args = data.decode().strip().partition(" ")
+                if command != "spawn" or len(fds) != 3:
+                    for fd in fds:
+                        os.close(fd)
+                    conn.close()
+                    continue
+                pid = os.fork()
+                if pid == 0:
+                    signal.set_wakeup_fd(-1)
+                    signal.signal(signal.SIGCHLD, signal.SIG_DFL)
+                    selector.close()
+                    for sock in [server, wakeup_r, wakeup_w, conn] + list(children.values()):
+                        sock.close()
+                    run_forked_plug(args.split(), fds, memory_max)
+                for fd in fds:
+                    os.close(fd)
+                conn.sendall(b"pid %d\n" % pid)
+                children[pid] = conn
+                selector.register(conn, selectors.EVENT_READ, pid)
+                partial[conn] = b""
+            elif key.fileobj is wakeup_r:
+                try:
+                    while wakeup_r.recv(64):
+                        pass
+                except BlockingIOError:
+                    pass
+                while children:
+                    try:
+                        pid, status = os.waitpid(-1, os.WNOHANG)
+                    except ChildProcessError:
+                        break
+                    if pid == 0:
+                        break
+                    conn = children.pop(pid, None)
+                    if conn is None:
+                        continue
+                    try:
+                        conn.sendall(b"exited %d\n" % status)
+                    except OSError:
+                        pass
+                    if partial.pop(conn, None) is not None:
+                        selector.unregister(conn)
+                    conn.close()
+            elif key.data is not None:
+                # "signal <signum>" for the plug of this connection. The
+                # pid is only in children until it has been reaped, so
+                # it cannot be somebody else's.
+                conn = key.fileobj
+                try:
+                    data = conn.recv(4096)
+                except OSError:
+                    data = b""
+                if not data:
+                    # The applet let go, the exit still gets reaped.
+                    partial.pop(conn, None)
+                    selector.unregister(conn)
+                    continue
+                lines = (partial[conn] + data).split(b"\n")
+                partial[conn] = lines.pop()
+                for line in lines:
+                    command, _, arg = line.decode(errors="replace").partition(" ")
+                    if command == "signal" and children.get(key.data) is conn:
+                        try:
+                            os.kill(key.data, int(arg))
+                        except (OSError, ValueError):
+                            pass
+            elif not os.read(sys.stdin.fileno(), 4096):
+                # The applet is gone, the plugs it had are on their own.
+                os.unlink(path)
+                return
+
+
+if __name__ == '__main__':
+    if "--zygote" in sys.argv:
+        memory_max = 0
+        if "--memory-max" in sys.argv:
+            memory_max = int(sys.argv[sys.argv.index("--memory-max") + 1])
+        run_zygote(sys.argv[sys.argv.index("--zygote") + 1], memory_max)
+    else:
+        run_plug()
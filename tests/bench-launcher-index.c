@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* Times launcher_index_merge() on a dock with hundreds of pinned
+ * launchers against the pairwise comparison it replaced, which read both
+ * desktop files again for every pair. */
+
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "launcher-index.h"
+
+#define N_PINNED		500
+#define N_POLICY		40
+#define ROUNDS			5
+
+
+static gchar *
+add_desktop_file (const gchar *dir, const gchar *id, const gchar *name, const gchar *exec)
+{
+	gchar *path, *data, *launcher;
+
+	path = g_strdup_printf ("%s/%s.desktop", dir, id);
+	data = g_strdup_printf ("[Desktop Entry]\nType=Application\nName=%s\nExec=%s %%U\n", name, exec);
+	if (!g_file_set_contents (path, data, -1, NULL))
+		g_error ("Could not write %s", path);
+
+	launcher = g_strdup_printf ("%s;%s", id, path);
+
+	g_free (data);
+	g_free (path);
+
+	return launcher;
+}
+
+static void
+get_name_exec (const gchar *launcher, gchar **name, gchar **exec)
+{
+	GKeyFile *keyfile = g_key_file_new ();
+
+	*name = *exec = NULL;
+	if (g_key_file_load_from_file (keyfile, strchr (launcher, ';') + 1, G_KEY_FILE_NONE, NULL)) {
+		*name = g_key_file_get_string (keyfile, G_KEY_FILE_DESKTOP_GROUP, G_KEY_FILE_DESKTOP_KEY_NAME, NULL);
+		*exec = g_key_file_get_string (keyfile, G_KEY_FILE_DESKTOP_GROUP, G_KEY_FILE_DESKTOP_KEY_EXEC, NULL);
+	}
+	g_key_file_free (keyfile);
+}
+
+static gboolean
+pairwise_contains (GSList *launchers, const gchar *launcher)
+{
+	GSList *l;
+	gboolean ret = FALSE;
+	gchar *name, *exec;
+
+	get_name_exec (launcher, &name, &exec);
+
+	for (l = launchers; l && !ret; l = l->next) {
+		gchar *l_name, *l_exec;
+
+		get_name_exec (l->data, &l_name, &l_exec);
+		ret = (g_strcmp0 (name, l_name) == 0 || g_strcmp0 (exec, l_exec) == 0);
+		g_free (l_name);
+		g_free (l_exec);
+	}
+
+	g_free (name);
+	g_free (exec);
+
+	return ret;
+}
+
+static GSList *
+pairwise_merge (GSList *old_launchers, GSList *new_launchers)
+{
+	GSList *l;
+	GSList *ret_launchers;
+
+	ret_launchers = g_slist_copy_deep (old_launchers, (GCopyFunc)g_strdup, NULL);
+
+	for (l = new_launchers; l; l = l->next) {
+		if (!pairwise_contains (ret_launchers, l->data))
+			ret_launchers = g_slist_append (ret_launchers, g_strdup (l->data));
+	}
+
+	return ret_launchers;
+}
+
+static void
+bench (const gchar *label,
+       GSList *(*merge) (GSList *, GSList *),
+       GSList *old_launchers,
+       GSList *new_launchers)
+{
+	guint i, length = 0;
+	gint64 start;
+
+	start = g_get_monotonic_time ();
+	for (i = 0; i < ROUNDS; i++) {
+		GSList *merged = merge (old_launchers, new_launchers);
+		length = g_slist_length (merged);
+		g_slist_free_full (merged, g_free);
+	}
+
+	g_print ("  %-10s %8.2f ms per merge (%u launchers)\n", label,
+	         (g_get_monotonic_time () - start) / 1000.0 / ROUNDS, length);
+}
+
+int
+main (int argc, char **argv)
+{
+	guint i;
+	gchar *dir;
+	GDir *gdir;
+	const gchar *name;
+	GSList *old_launchers = NULL, *new_launchers = NULL;
+
+	dir = g_dir_make_tmp ("bench-launcher-index-XXXXXX", NULL);
+	if (!dir)
+		g_error ("Could not create a temporary directory");
+
+	for (i = 0; i < N_PINNED; i++) {
+		gchar *id = g_strdup_printf ("pinned-%03u", i);
+		gchar *app_name = g_strdup_printf ("Application %u", i);
+		gchar *exec = g_strdup_printf ("/usr/bin/app-%u", i);
+
+		old_launchers = g_slist_prepend (old_launchers, add_desktop_file (dir, id, app_name, exec));
+		g_free (id);
+		g_free (app_name);
+		g_free (exec);
+	}
+	old_launchers = g_slist_reverse (old_launchers);
+
+	/* every other launcher of the policy is already pinned */
+	for (i = 0; i < N_POLICY; i++) {
+		gchar *id = g_strdup_printf ("shortcut-%02u", i);
+		gchar *app_name = g_strdup_printf ("Website %u", i);
+		gchar *exec = g_strdup_printf ("/usr/bin/app-%u", (i % 2) ? N_PINNED + i : i);
+
+		new_launchers = g_slist_prepend (new_launchers, add_desktop_file (dir, id, app_name, exec));
+		g_free (id);
+		g_free (app_name);
+		g_free (exec);
+	}
+	new_launchers = g_slist_reverse (new_launchers);
+
+	g_print ("%u pinned, %u from the policy:\n", N_PINNED, N_POLICY);
+	bench ("pairwise", pairwise_merge, old_launchers, new_launchers);
+	bench ("index", launcher_index_merge, old_launchers, new_launchers);
+
+	g_slist_free_full (old_launchers, g_free);
+	g_slist_free_full (new_launchers, g_free);
+
+	gdir = g_dir_open (dir, 0, NULL);
+	while ((name = g_dir_read_name (gdir)) != NULL) {
+		gchar *path = g_build_filename (dir, name, NULL);
+		g_unlink (path);
+		g_free (path);
+	}
+	g_dir_close (gdir);
+	g_rmdir (dir);
+	g_free (dir);
+
+	return 0;
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* Times panel_g_utf8_strstrcase() against the full Unicode search on
+ * launcher names and Exec lines: `make bench` */
+
+#include <stdio.h>
+
+#include "panel-glib.c"
+
+#include "strstrcase-corpus.h"
+
+#define ROUNDS	20000
+
+
+static const char *
+unicode_strstrcase (const char *haystack, const char *needle)
+{
+	gunichar *nuni;
+	gint nlen;
+
+	if (*needle == '\0') return haystack;
+	if (*haystack == '\0') return NULL;
+
+	nuni = g_alloca (sizeof (gunichar) * strlen (needle));
+
+	nlen = fold_needle (needle, nuni);
+	if (nlen < 0) return NULL;
+
+	return strstrcase_unicode (haystack, nuni, nlen);
+}
+
+static void
+run (const char  *label,
+     const char  *(*func) (const char *, const char *),
+     gboolean     ascii_only)
+{
+	guint i, j, r;
+	guint n_searches = 0, n_hits = 0;
+	gint64 start, elapsed;
+
+	start = g_get_monotonic_time ();
+
+	for (r = 0; r < ROUNDS; r++) {
+		for (i = 0; corpus_haystacks[i] != NULL; i++) {
+			if (ascii_only && !is_ascii (corpus_haystacks[i]))
+				continue;
+
+			for (j = 0; corpus_needles[j] != NULL; j++) {
+				if (ascii_only && !is_ascii (corpus_needles[j]))
+					continue;
+
+				if (func (corpus_haystacks[i], corpus_needles[j]))
+					n_hits++;
+				n_searches++;
+			}
+		}
+	}
+
+	elapsed = g_get_monotonic_time () - start;
+
+	printf ("%-8s %-7s %10u searches %8u hits %8.1f ns/search\n",
+	        ascii_only ? "ascii" : "mixed", label, n_searches, n_hits,
+	        (gdouble) elapsed * 1000 / MAX (n_searches, 1));
+}
+
+int
+main (int argc, char **argv)
+{
+	run ("unicode", unicode_strstrcase, TRUE);
+	run ("fast", panel_g_utf8_strstrcase, TRUE);
+	run ("unicode", unicode_strstrcase, FALSE);
+	run ("fast", panel_g_utf8_strstrcase, FALSE);
+
+	return 0;
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __STRSTRCASE_CORPUS_H__
+#define __STRSTRCASE_CORPUS_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Names and Exec lines like the ones launchers are matched against */
+static const char *corpus_haystacks[] = {
+	"Firefox Web Browser",
+	"Mozilla FIREFOX",
+	"/usr/bin/firefox-esr %u",
+	"google-chrome-stable --app=https://portal.gooroom.kr/mail --profile-directory=Default",
+	"/usr/bin/libreoffice --writer %U",
+	"LibreOffice Calc",
+	"gnome-terminal -- bash -c 'ssh admin@10.0.0.1'",
+	"Visual Studio Code",
+	"/opt/hancom/office/hwp %F",
+	"한컴오피스 한글",
+	"구름 브라우저 Gooroom Browser",
+	"웹 메일 (Webmail)",
+	"Café Manager",
+	"CAFÉ MANAGER",
+	"\xe2\x84\xaa" "elvin Converter",
+	"\xc4\xb0nternet Explorer",
+	"Straße und Weg",
+	"Σίσυφος ΣΊΣΥΦΟΣ",
+	"",
+	NULL
+};
+
+static const char *corpus_needles[] = {
+	"fire",
+	"FIREFOX",
+	"%u",
+	"gooroom",
+	"--app=",
+	"calc",
+	"ssh",
+	"code",
+	"hwp",
+	"한글",
+	"브라우저",
+	"mail",
+	"café",
+	"CAFÉ",
+	"kelvin",
+	"internet",
+	"STRASSE",
+	"σίσυφος",
+	"x",
+	"",
+	NULL
+};
+
+/* Pieces for random haystacks and needles: ASCII in both cases,
+ * characters that lowercase to ASCII, Hangul, accents and broken
+ * UTF-8 */
+static const char *corpus_pieces[] = {
+	"a", "B", "k", "K", "i", "I", "o", "O", " ", "-", "%", "/", "=",
+	"\xe2\x84\xaa",		/* KELVIN SIGN */
+	"\xc4\xb0",			/* LATIN CAPITAL LETTER I WITH DOT ABOVE */
+	"\xc3\xa9", "\xc3\x89",	/* é É */
+	"\xed\x95\x9c",		/* 한 */
+	"\xea\xb8\x80",		/* 글 */
+	"\xce\xa3", "\xcf\x83",	/* Σ σ */
+	"\x80",				/* stray continuation byte */
+	"\xc3",				/* truncated sequence */
+	"\xff"
+};
+
+G_END_DECLS
+
+#endif /* __STRSTRCASE_CORPUS_H__ */
@@ -0,0 +1,307 @@
+/*
+ * Copyright (C) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* Runs FaviconFetcher against a SoupServer on the loopback interface. */
+
+#include <glib.h>
+#include <gio/gio.h>
+#include <libsoup/soup.h>
+
+#include "favicon-fetcher.h"
+
+/* FETCH_RETRY_DELAY: 250 ms, then 500 ms before the two retries */
+#define RETRY_WAIT		750 /* ms */
+#define ICON_ETAG		"\"favicon-1\""
+
+static const guchar icon_data[] = {
+	0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n', 0, 0, 0, 0x0d, 'I', 'H', 'D', 'R'
+};
+
+
+typedef struct
+{
+	SoupServer  *server;
+	GUri        *base;
+	/* requests that reached the server */
+	guint        n_requests;
+	/* the first requests to /flaky that are dropped */
+	guint        n_drops;
+	/* paused messages of /stall */
+	GSList      *stalled;
+
+	guint        n_results;
+	FaviconFetchResult result;
+} Fixture;
+
+static void
+server_cb (SoupServer        *server,
+           SoupServerMessage *msg,
+           const char        *path,
+           GHashTable        *query,
+           gpointer           user_data)
+{
+	const gchar *etag;
+	Fixture *fixture = (Fixture *)user_data;
+	SoupMessageHeaders *request_headers = soup_server_message_get_request_headers (msg);
+	SoupMessageHeaders *response_headers = soup_server_message_get_response_headers (msg);
+
+	fixture->n_requests++;
+
+	if (g_str_equal (path, "/flaky") && fixture->n_drops > 0) {
+		/* no response at all, the client sees a transport error */
+		GIOStream *stream = soup_server_message_steal_connection (msg);
+		g_io_stream_close (stream, NULL, NULL);
+		g_object_unref (stream);
+		fixture->n_drops--;
+		return;
+	}
+
+	if (g_str_equal (path, "/stall")) {
+		soup_server_message_pause (msg);
+		fixture->stalled = g_slist_prepend (fixture->stalled, g_object_ref (msg));
+		return;
+	}
+
+	if (g_str_equal (path, "/icon.png") || g_str_equal (path, "/flaky")) {
+		etag = soup_message_headers_get_one (request_headers, "If-None-Match");
+		soup_message_headers_replace (response_headers, "ETag", ICON_ETAG);
+
+		if (g_strcmp0 (etag, ICON_ETAG) == 0) {
+			soup_server_message_set_status (msg, SOUP_STATUS_NOT_MODIFIED, NULL);
+			return;
+		}
+
+		soup_server_message_set_status (msg, SOUP_STATUS_OK, NULL);
+		soup_server_message_set_response (msg, "image/png", SOUP_MEMORY_STATIC,
+                                          (const char *)icon_data, sizeof (icon_data));
+		return;
+	}
+
+	soup_server_message_set_status (msg, SOUP_STATUS_NOT_FOUND, NULL);
+}
+
+static void
+fixture_set_up (Fixture *fixture, gconstpointer data)
+{
+	GSList *uris;
+	GError *error = NULL;
+
+	fixture->server = soup_server_new (NULL, NULL);
+	soup_server_add_handler (fixture->server, NULL, server_cb, fixture, NULL);
+
+	soup_server_listen_local (fixture->server, 0, SOUP_SERVER_LISTEN_IPV4_ONLY, &error);
+	g_assert_no_error (error);
+
+	uris = soup_server_get_uris (fixture->server);
+	fixture->base = g_uri_ref (uris->data);
+	g_slist_free_full (uris, (GDestroyNotify)g_uri_unref);
+}
+
+static void
+fixture_tear_down (Fixture *fixture, gconstpointer data)
+{
+	GSList *l;
+
+	for (l = fixture->stalled; l; l = l->next)
+		soup_server_message_unpause (l->data);
+	g_slist_free_full (fixture->stalled, g_object_unref);
+
+	g_bytes_unref (fixture->result.body);
+	g_uri_unref (fixture->base);
+
+	soup_server_disconnect (fixture->server);
+	g_object_unref (fixture->server);
+}
+
+static gchar *
+fixture_url (Fixture *fixture, const gchar *path)
+{
+	return g_strdup_printf ("http://127.0.0.1:%d%s", g_uri_get_port (fixture->base), path);
+}
+
+/* Keeps the last result; the header values only live as long as the
+ * callback, so only whether there were any is kept. */
+static void
+fetched_cb (const gchar              *url,
+            const FaviconFetchResult *result,
+            gpointer                  user_data)
+{
+	Fixture *fixture = (Fixture *)user_data;
+
+	fixture->n_results++;
+
+	g_clear_pointer (&fixture->result.body, g_bytes_unref);
+	fixture->result.status        = result->status;
+	fixture->result.cancelled     = result->cancelled;
+	fixture->result.body          = result->body ? g_bytes_ref (result->body) : NULL;
+	fixture->result.etag          = result->etag ? ICON_ETAG : NULL;
+}
+
+static void
+fetch (Fixture *fixture, const gchar *path, const gchar *etag, guint timeout_ms)
+{
+	gchar *url;
+	FaviconFetcher *fetcher;
+
+	url = fixture_url (fixture, path);
+
+	fetcher = favicon_fetcher_new (2, timeout_ms);
+	favicon_fetcher_add (fetcher, url, etag, NULL, fetched_cb, fixture, NULL);
+	favicon_fetcher_run (fetcher, NULL);
+	favicon_fetcher_free (fetcher);
+
+	g_assert_cmpuint (fixture->n_results, ==, 1);
+
+	g_free (url);
+}
+
+static void
+test_ok (Fixture *fixture, gconstpointer data)
+{
+	fetch (fixture, "/icon.png", NULL, 5000);
+
+	g_assert_cmpuint (fixture->result.status, ==, SOUP_STATUS_OK);
+	g_assert_false (fixture->result.cancelled);
+	g_assert_nonnull (fixture->result.body);
+	g_assert_cmpmem (g_bytes_get_data (fixture->result.body, NULL), g_bytes_get_size (fixture->result.body),
+                     icon_data, sizeof (icon_data));
+	g_assert_nonnull (fixture->result.etag);
+}
+
+static void
+test_not_modified (Fixture *fixture, gconstpointer data)
+{
+	fetch (fixture, "/icon.png", ICON_ETAG, 5000);
+
+	g_assert_cmpuint (fixture->result.status, ==, SOUP_STATUS_NOT_MODIFIED);
+	g_assert_null (fixture->result.body);
+}
+
+static void
+test_not_found (Fixture *fixture, gconstpointer data)
+{
+	fetch (fixture, "/missing.png", NULL, 5000);
+
+	/* no retry for an answer from the server */
+	g_assert_cmpuint (fixture->result.status, ==, SOUP_STATUS_NOT_FOUND);
+	g_assert_null (fixture->result.body);
+	g_assert_cmpuint (fixture->n_requests, ==, 1);
+}
+
+static void
+test_retry (Fixture *fixture, gconstpointer data)
+{
+	gint64 start;
+
+	fixture->n_drops = 2;
+
+	start = g_get_monotonic_time ();
+	fetch (fixture, "/flaky", NULL, 5000);
+
+	g_assert_cmpuint (fixture->result.status, ==, SOUP_STATUS_OK);
+	g_assert_cmpuint (fixture->n_requests, ==, 3);
+	g_assert_cmpint (g_get_monotonic_time () - start, >=, RETRY_WAIT * 1000);
+}
+
+static void
+test_retry_deadline (Fixture *fixture, gconstpointer data)
+{
+	gint64 start;
+
+	fixture->n_drops = 2;
+
+	/* room for the first retry after 250 ms, not for the second */
+	start = g_get_monotonic_time ();
+	fetch (fixture, "/flaky", NULL, 600);
+
+	g_assert_cmpuint (fixture->result.status, ==, 0);
+	g_assert_false (fixture->result.cancelled);
+	g_assert_cmpuint (fixture->n_requests, ==, 2);
+	g_assert_cmpint (g_get_monotonic_time () - start, <, 600 * 1000);
+}
+
+static void
+test_deadline (Fixture *fixture, gconstpointer data)
+{
+	gint64 start;
+
+	start = g_get_monotonic_time ();
+	fetch (fixture, "/stall", NULL, 300);
+
+	/* a timeout is a failure, not a cancellation */
+	g_assert_cmpuint (fixture->result.status, ==, 0);
+	g_assert_false (fixture->result.cancelled);
+	g_assert_cmpint (g_get_monotonic_time () - start, >=, 300 * 1000);
+}
+
+static gboolean
+cancel_cb (gpointer user_data)
+{
+	g_cancellable_cancel (G_CANCELLABLE (user_data));
+
+	return FALSE;
+}
+
+static void
+test_cancel (Fixture *fixture, gconstpointer data)
+{
+	gchar *url;
+	GCancellable *cancellable;
+	FaviconFetcher *fetcher;
+
+	url = fixture_url (fixture, "/stall");
+
+	/* one request stalls, the other one never goes out */
+	fetcher = favicon_fetcher_new (1, 5000);
+	favicon_fetcher_add (fetcher, url, NULL, NULL, fetched_cb, fixture, NULL);
+	favicon_fetcher_add (fetcher, url, NULL, NULL, fetched_cb, fixture, NULL);
+
+	cancellable = g_cancellable_new ();
+	g_timeout_add (100, cancel_cb, cancellable);
+	favicon_fetcher_run (fetcher, cancellable);
+	favicon_fetcher_free (fetcher);
+
+	g_assert_cmpuint (fixture->n_results, ==, 2);
+	g_assert_cmpuint (fixture->result.status, ==, 0);
+	g_assert_true (fixture->result.cancelled);
+
+	g_object_unref (cancellable);
+	g_free (url);
+}
+
+int
+main (int argc, char **argv)
+{
+	/* straight to the loopback interface, whatever proxy is set up */
+	g_setenv ("GIO_USE_PROXY_RESOLVER", "dummy", TRUE);
+
+	g_test_init (&argc, &argv, NULL);
+
+#define ADD_TEST(path, func) \
+	g_test_add (path, Fixture, NULL, fixture_set_up, func, fixture_tear_down)
+
+	ADD_TEST ("/favicon-fetcher/ok", test_ok);
+	ADD_TEST ("/favicon-fetcher/not-modified", test_not_modified);
+	ADD_TEST ("/favicon-fetcher/not-found", test_not_found);
+	ADD_TEST ("/favicon-fetcher/retry", test_retry);
+	ADD_TEST ("/favicon-fetcher/retry-deadline", test_retry_deadline);
+	ADD_TEST ("/favicon-fetcher/deadline", test_deadline);
+	ADD_TEST ("/favicon-fetcher/cancel", test_cancel);
+
+	return g_test_run ();
+}
@@ -0,0 +1,241 @@
+/*
+ * Copyright (C) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* Checks which launchers LauncherIndex takes for duplicates, reading
+ * desktop files written to a temporary directory. */
+
+#include <stdarg.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "launcher-index.h"
+
+
+typedef struct
+{
+	gchar *dir;
+} Fixture;
+
+/* Writes a desktop file and returns the launcher as DockbarX stores it;
+ * a NULL name or exec leaves the key out. */
+static gchar *
+add_desktop_file (Fixture     *fixture,
+                  const gchar *id,
+                  const gchar *name,
+                  const gchar *exec)
+{
+	GString *data;
+	gchar *path, *launcher;
+
+	data = g_string_new ("[Desktop Entry]\nType=Application\n");
+	if (name)
+		g_string_append_printf (data, "Name=%s\n", name);
+	if (exec)
+		g_string_append_printf (data, "Exec=%s\n", exec);
+
+	path = g_strdup_printf ("%s/%s.desktop", fixture->dir, id);
+	g_assert_true (g_file_set_contents (path, data->str, data->len, NULL));
+
+	launcher = g_strdup_printf ("%s;%s", id, path);
+
+	g_string_free (data, TRUE);
+	g_free (path);
+
+	return launcher;
+}
+
+static void
+fixture_set_up (Fixture *fixture, gconstpointer data)
+{
+	fixture->dir = g_dir_make_tmp ("test-launcher-index-XXXXXX", NULL);
+	g_assert_nonnull (fixture->dir);
+}
+
+static void
+fixture_tear_down (Fixture *fixture, gconstpointer data)
+{
+	GDir *dir;
+	const gchar *name;
+
+	dir = g_dir_open (fixture->dir, 0, NULL);
+	while ((name = g_dir_read_name (dir)) != NULL) {
+		gchar *path = g_build_filename (fixture->dir, name, NULL);
+		g_unlink (path);
+		g_free (path);
+	}
+	g_dir_close (dir);
+
+	g_rmdir (fixture->dir);
+	g_free (fixture->dir);
+}
+
+/* Adds launchers to a new index, expecting TRUE or FALSE in turn. */
+static void
+assert_added (Fixture *fixture, ...)
+{
+	va_list args;
+	const gchar *id;
+	LauncherIndex *index;
+
+	index = launcher_index_new ();
+
+	va_start (args, fixture);
+	while ((id = va_arg (args, const gchar *)) != NULL) {
+		const gchar *name = va_arg (args, const gchar *);
+		const gchar *exec = va_arg (args, const gchar *);
+		gboolean expected = va_arg (args, gboolean);
+		gchar *launcher;
+
+		launcher = add_desktop_file (fixture, id, name, exec);
+		if (launcher_index_add (index, launcher) != expected)
+			g_error ("%s (Name=%s, Exec=%s) %s", id, name, exec,
+			         expected ? "was taken for a duplicate" : "was not taken for a duplicate");
+		g_free (launcher);
+	}
+	va_end (args);
+
+	launcher_index_free (index);
+}
+
+static void
+test_name (Fixture *fixture, gconstpointer data)
+{
+	assert_added (fixture,
+	              "a", "Firefox", "firefox", TRUE,
+	              "b", "FIREFOX", "firefox-esr", FALSE,
+	              "c", "Firefox Web", "firefox-web", TRUE,
+	              NULL);
+}
+
+static void
+test_casefold (Fixture *fixture, gconstpointer data)
+{
+	/* casefolded and compatibility normalized */
+	assert_added (fixture,
+	              "a", "Straße", "a", TRUE,
+	              "b", "STRASSE", "b", FALSE,
+	              "c", "\xef\xac\x81le manager", "c", TRUE,	/* U+FB01 LATIN SMALL LIGATURE FI */
+	              "d", "File Manager", "d", FALSE,
+	              "e", "웹 메일", "e", TRUE,
+	              "f", "웹 메일", "f", FALSE,
+	              NULL);
+}
+
+static void
+test_exec (Fixture *fixture, gconstpointer data)
+{
+	/* field codes and white space do not tell commands apart */
+	assert_added (fixture,
+	              "a", "Browser", "firefox %u", TRUE,
+	              "b", "Web", "firefox   %U", FALSE,
+	              "c", "Web", "firefox", FALSE,
+	              "d", "Files", "nautilus %F --new-window", TRUE,
+	              "e", "Folders", "nautilus --new-window", FALSE,
+	              /* %% is a literal percent sign */
+	              "f", "Percent", "firefox %%", TRUE,
+	              NULL);
+}
+
+static void
+test_untouched (Fixture *fixture, gconstpointer data)
+{
+	/* a rejected launcher leaves nothing behind, so its Exec is
+	 * still free for the next one */
+	assert_added (fixture,
+	              "a", "Mail", "mail-a", TRUE,
+	              "b", "Mail", "mail-b", FALSE,
+	              "c", "Webmail", "mail-b", TRUE,
+	              NULL);
+}
+
+static void
+test_missing (Fixture *fixture, gconstpointer data)
+{
+	LauncherIndex *index;
+
+	/* without a Name and Exec to compare, nothing is a duplicate */
+	index = launcher_index_new ();
+	g_assert_true (launcher_index_add (index, "a;/nonexistent/a.desktop"));
+	g_assert_true (launcher_index_add (index, "b;/nonexistent/b.desktop"));
+	launcher_index_free (index);
+
+	assert_added (fixture,
+	              "a", NULL, NULL, TRUE,
+	              "b", NULL, NULL, TRUE,
+	              NULL);
+}
+
+static void
+test_merge (Fixture *fixture, gconstpointer data)
+{
+	GSList *old_launchers = NULL, *new_launchers = NULL, *merged;
+	gchar *old_a, *old_b, *old_c, *new_a, *new_b, *new_c;
+
+	/* pinned by the user, even when they repeat each other */
+	old_a = add_desktop_file (fixture, "old-a", "Firefox", "firefox %u");
+	old_b = add_desktop_file (fixture, "old-b", "Terminal", "gnome-terminal");
+	old_c = add_desktop_file (fixture, "old-c", "terminal", "xterm");
+	old_launchers = g_slist_append (old_launchers, old_a);
+	old_launchers = g_slist_append (old_launchers, old_b);
+	old_launchers = g_slist_append (old_launchers, old_c);
+
+	/* from the policy: one repeats a pinned launcher, one an earlier
+	 * launcher of the policy */
+	new_a = add_desktop_file (fixture, "shortcut-00", "Mozilla Firefox", "firefox");
+	new_b = add_desktop_file (fixture, "shortcut-01", "Webmail", "mail");
+	new_c = add_desktop_file (fixture, "shortcut-02", "WEBMAIL", "mail --compose");
+	new_launchers = g_slist_append (new_launchers, new_a);
+	new_launchers = g_slist_append (new_launchers, new_b);
+	new_launchers = g_slist_append (new_launchers, new_c);
+
+	merged = launcher_index_merge (old_launchers, new_launchers);
+	g_assert_cmpuint (g_slist_length (merged), ==, 4);
+	g_assert_cmpstr (g_slist_nth_data (merged, 0), ==, old_a);
+	g_assert_cmpstr (g_slist_nth_data (merged, 1), ==, old_b);
+	g_assert_cmpstr (g_slist_nth_data (merged, 2), ==, old_c);
+	g_assert_cmpstr (g_slist_nth_data (merged, 3), ==, new_b);
+	g_slist_free_full (merged, g_free);
+
+	/* nothing new, nothing at all */
+	merged = launcher_index_merge (old_launchers, NULL);
+	g_assert_cmpuint (g_slist_length (merged), ==, 3);
+	g_slist_free_full (merged, g_free);
+	g_assert_null (launcher_index_merge (NULL, NULL));
+
+	g_slist_free_full (old_launchers, g_free);
+	g_slist_free_full (new_launchers, g_free);
+}
+
+int
+main (int argc, char **argv)
+{
+	g_test_init (&argc, &argv, NULL);
+
+#define ADD_TEST(path, func) \
+	g_test_add (path, Fixture, NULL, fixture_set_up, func, fixture_tear_down)
+
+	ADD_TEST ("/launcher-index/name", test_name);
+	ADD_TEST ("/launcher-index/casefold", test_casefold);
+	ADD_TEST ("/launcher-index/exec", test_exec);
+	ADD_TEST ("/launcher-index/untouched", test_untouched);
+	ADD_TEST ("/launcher-index/missing", test_missing);
+	ADD_TEST ("/launcher-index/merge", test_merge);
+
+	return g_test_run ();
+}
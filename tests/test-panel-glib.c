@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* Checks the ASCII fast path of panel_g_utf8_strstrcase() against the
+ * full Unicode search it replaced, which is still in panel-glib.c. */
+
+#include "panel-glib.c"
+
+#include "strstrcase-corpus.h"
+
+#define N_RANDOM		200000
+#define N_RANDOM_SLOW	5000000
+#define MAX_PIECES		12
+
+
+/* panel_g_utf8_strstrcase() as it was before the fast path */
+static const char *
+reference_strstrcase (const char *haystack, const char *needle)
+{
+	gunichar *nuni;
+	gint nlen;
+
+	if (haystack == NULL) return NULL;
+	if (needle == NULL) return NULL;
+	if (strlen (needle) == 0) return haystack;
+	if (strlen (haystack) == 0) return NULL;
+
+	nuni = g_alloca (sizeof (gunichar) * strlen (needle));
+
+	nlen = fold_needle (needle, nuni);
+	if (nlen < 0) return NULL;
+
+	return strstrcase_unicode (haystack, nuni, nlen);
+}
+
+static void
+assert_same (const char *haystack, const char *needle)
+{
+	const char *expected, *found;
+
+	expected = reference_strstrcase (haystack, needle);
+	found = panel_g_utf8_strstrcase (haystack, needle);
+
+	if (expected != found)
+		g_error ("\"%s\" in \"%s\": expected offset %d, got %d",
+		         needle ? needle : "(null)", haystack ? haystack : "(null)",
+		         expected ? (gint) (expected - haystack) : -1,
+		         found ? (gint) (found - haystack) : -1);
+}
+
+static gchar *
+random_string (void)
+{
+	GString *str;
+	gint i, n;
+
+	str = g_string_new (NULL);
+	n = g_test_rand_int_range (0, MAX_PIECES);
+	for (i = 0; i < n; i++)
+		g_string_append (str, corpus_pieces[g_test_rand_int_range (0, G_N_ELEMENTS (corpus_pieces))]);
+
+	return g_string_free (str, FALSE);
+}
+
+static void
+test_expected (void)
+{
+	const char *haystack;
+
+	g_assert_null (panel_g_utf8_strstrcase (NULL, "a"));
+	g_assert_null (panel_g_utf8_strstrcase ("a", NULL));
+	g_assert_null (panel_g_utf8_strstrcase ("", "a"));
+
+	haystack = "";
+	g_assert_true (panel_g_utf8_strstrcase (haystack, "") == haystack);
+
+	haystack = "Mozilla FIREFOX";
+	g_assert_true (panel_g_utf8_strstrcase (haystack, "firefox") == haystack + 8);
+	g_assert_null (panel_g_utf8_strstrcase (haystack, "chrome"));
+
+	/* KELVIN SIGN lowercases to 'k' */
+	haystack = "\xe2\x84\xaa" "elvin";
+	g_assert_true (panel_g_utf8_strstrcase (haystack, "kelvin") == haystack);
+	haystack = "to \xe2\x84\xaa";
+	g_assert_true (panel_g_utf8_strstrcase (haystack, "o k") == haystack + 1);
+
+	haystack = "구름 브라우저";
+	g_assert_true (panel_g_utf8_strstrcase (haystack, "브라우저") == haystack + strlen ("구름 "));
+
+	/* the search stops at broken UTF-8 */
+	g_assert_null (panel_g_utf8_strstrcase ("ab\x80" "cd", "cd"));
+	g_assert_null (panel_g_utf8_strstrcase ("abcd", "c\x80"));
+}
+
+static void
+test_corpus (void)
+{
+	guint i, j;
+
+	for (i = 0; corpus_haystacks[i] != NULL; i++)
+		for (j = 0; corpus_needles[j] != NULL; j++)
+			assert_same (corpus_haystacks[i], corpus_needles[j]);
+}
+
+static void
+test_random (void)
+{
+	gint i, n;
+
+	n = g_test_slow () ? N_RANDOM_SLOW : N_RANDOM;
+
+	for (i = 0; i < n; i++) {
+		gchar *haystack, *needle;
+
+		haystack = random_string ();
+		/* short needles match often enough to be interesting */
+		needle = random_string ();
+		if (strlen (needle) > 6)
+			needle[g_test_rand_int_range (0, 6)] = '\0';
+
+		assert_same (haystack, needle);
+
+		g_free (haystack);
+		g_free (needle);
+	}
+}
+
+int
+main (int argc, char **argv)
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/panel-glib/strstrcase/expected", test_expected);
+	g_test_add_func ("/panel-glib/strstrcase/corpus", test_corpus);
+	g_test_add_func ("/panel-glib/strstrcase/random", test_random);
+
+	return g_test_run ();
+}